@@ -0,0 +1,251 @@
+#include <cassert>
+#include <cstdlib>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define GEOM_SSE2 1
+#endif
+
+#include "tri2d.hpp"
+
+namespace geom {
+
+void Triangles::clear()
+{
+    this->x0.clear();
+    this->y0.clear();
+    this->x1.clear();
+    this->y1.clear();
+    this->x2.clear();
+    this->y2.clear();
+}
+
+void Triangles::push(const Tri& t)
+{
+    assert(std::abs(t.x0) < COORD_LIMIT && std::abs(t.y0) < COORD_LIMIT);
+    assert(std::abs(t.x1) < COORD_LIMIT && std::abs(t.y1) < COORD_LIMIT);
+    assert(std::abs(t.x2) < COORD_LIMIT && std::abs(t.y2) < COORD_LIMIT);
+    this->x0.push_back(t.x0);
+    this->y0.push_back(t.y0);
+    this->x1.push_back(t.x1);
+    this->y1.push_back(t.y1);
+    this->x2.push_back(t.x2);
+    this->y2.push_back(t.y2);
+}
+
+Tri Triangles::get(size_t i) const
+{
+    return Tri{ this->x0[i], this->y0[i], this->x1[i], this->y1[i], this->x2[i], this->y2[i] };
+}
+
+bool point_in_tri(int32_t px, int32_t py, const Tri& t)
+{
+    int32_t area = orient(t.x0, t.y0, t.x1, t.y1, t.x2, t.y2);
+    int32_t d0 = orient(t.x0, t.y0, t.x1, t.y1, px, py);
+    int32_t d1 = orient(t.x1, t.y1, t.x2, t.y2, px, py);
+    int32_t d2 = orient(t.x2, t.y2, t.x0, t.y0, px, py);
+    if (area > 0)
+        return d0 >= 0 && d1 >= 0 && d2 >= 0;
+    if (area < 0)
+        return d0 <= 0 && d1 <= 0 && d2 <= 0;
+    return false;
+}
+
+bool tri_in_tri(const Tri& a, const Tri& b)
+{
+    return point_in_tri(a.x0, a.y0, b) && point_in_tri(a.x1, a.y1, b) && point_in_tri(a.x2, a.y2, b);
+}
+
+// some edge of a has every vertex of b strictly on its outside
+static bool separates(const Tri& a, int32_t area, const Tri& b)
+{
+    const int32_t ax[3] = { a.x0, a.x1, a.x2 };
+    const int32_t ay[3] = { a.y0, a.y1, a.y2 };
+    for (int e = 0; e < 3; e++) {
+        int n = (e + 1) % 3;
+        int32_t o0 = orient(ax[e], ay[e], ax[n], ay[n], b.x0, b.y0);
+        int32_t o1 = orient(ax[e], ay[e], ax[n], ay[n], b.x1, b.y1);
+        int32_t o2 = orient(ax[e], ay[e], ax[n], ay[n], b.x2, b.y2);
+        if (area > 0 && o0 < 0 && o1 < 0 && o2 < 0)
+            return true;
+        if (area < 0 && o0 > 0 && o1 > 0 && o2 > 0)
+            return true;
+    }
+    return false;
+}
+
+bool tri_overlap(const Tri& a, const Tri& b)
+{
+    // convex, so they're apart only if an edge of one of them separates them
+    int32_t area_a = orient(a.x0, a.y0, a.x1, a.y1, a.x2, a.y2);
+    int32_t area_b = orient(b.x0, b.y0, b.x1, b.y1, b.x2, b.y2);
+    if (area_a == 0 || area_b == 0)
+        return false;
+    return !separates(a, area_a, b) && !separates(b, area_b, a);
+}
+
+#ifdef GEOM_SSE2
+
+// four triangles' coordinates, one per lane
+struct Lanes {
+    __m128i x0, y0, x1, y1, x2, y2;
+
+    Lanes(const Triangles& tris, size_t i) {
+        x0 = _mm_loadu_si128((const __m128i *)(tris.x0.data() + i));
+        y0 = _mm_loadu_si128((const __m128i *)(tris.y0.data() + i));
+        x1 = _mm_loadu_si128((const __m128i *)(tris.x1.data() + i));
+        y1 = _mm_loadu_si128((const __m128i *)(tris.y1.data() + i));
+        x2 = _mm_loadu_si128((const __m128i *)(tris.x2.data() + i));
+        y2 = _mm_loadu_si128((const __m128i *)(tris.y2.data() + i));
+    }
+};
+
+// lo in the low 16 bits of each lane and hi in the high ones, both must fit in 16 bits
+static inline __m128i pack16(__m128i lo, __m128i hi)
+{
+    return _mm_or_si128(_mm_and_si128(lo, _mm_set1_epi32(0xffff)), _mm_slli_epi32(hi, 16));
+}
+
+static inline __m128i orient4(__m128i ax, __m128i ay, __m128i bx, __m128i by, __m128i cx, __m128i cy)
+{
+    // edge vectors fit in 16 bits, one madd gives both products and their difference
+    __m128i l = pack16(_mm_sub_epi32(bx, ax), _mm_sub_epi32(ay, by));
+    __m128i r = pack16(_mm_sub_epi32(cy, ay), _mm_sub_epi32(cx, ax));
+    return _mm_madd_epi16(l, r);
+}
+
+// lanes where (px, py) is inside, area is the triangles' orientation
+static inline __m128i inside4(const Lanes& t, __m128i area, __m128i px, __m128i py)
+{
+    __m128i zero = _mm_setzero_si128();
+    __m128i d0 = orient4(t.x0, t.y0, t.x1, t.y1, px, py);
+    __m128i d1 = orient4(t.x1, t.y1, t.x2, t.y2, px, py);
+    __m128i d2 = orient4(t.x2, t.y2, t.x0, t.y0, px, py);
+    __m128i any_neg = _mm_or_si128(_mm_or_si128(_mm_cmplt_epi32(d0, zero), _mm_cmplt_epi32(d1, zero)), _mm_cmplt_epi32(d2, zero));
+    __m128i any_pos = _mm_or_si128(_mm_or_si128(_mm_cmpgt_epi32(d0, zero), _mm_cmpgt_epi32(d1, zero)), _mm_cmpgt_epi32(d2, zero));
+    __m128i ccw = _mm_andnot_si128(any_neg, _mm_cmpgt_epi32(area, zero));
+    __m128i cw = _mm_andnot_si128(any_pos, _mm_cmplt_epi32(area, zero));
+    return _mm_or_si128(ccw, cw);
+}
+
+static inline void store4(__m128i mask, uint8_t *out)
+{
+    int bits = _mm_movemask_ps(_mm_castsi128_ps(mask));
+    out[0] = bits & 1;
+    out[1] = (bits >> 1) & 1;
+    out[2] = (bits >> 2) & 1;
+    out[3] = (bits >> 3) & 1;
+}
+
+static inline __m128i area4(const Lanes& t)
+{
+    return orient4(t.x0, t.y0, t.x1, t.y1, t.x2, t.y2);
+}
+
+static inline __m128i contains4(const Lanes& t, const Tri& q)
+{
+    __m128i area = area4(t);
+    __m128i in = inside4(t, area, _mm_set1_epi32(q.x0), _mm_set1_epi32(q.y0));
+    in = _mm_and_si128(in, inside4(t, area, _mm_set1_epi32(q.x1), _mm_set1_epi32(q.y1)));
+    return _mm_and_si128(in, inside4(t, area, _mm_set1_epi32(q.x2), _mm_set1_epi32(q.y2)));
+}
+
+#endif
+
+void points_in_tris(const Triangles& tris, size_t begin, size_t end, int32_t px, int32_t py, uint8_t *out)
+{
+    size_t i = begin;
+#ifdef GEOM_SSE2
+    __m128i vx = _mm_set1_epi32(px);
+    __m128i vy = _mm_set1_epi32(py);
+    for (; i + 4 <= end; i += 4) {
+        Lanes t = Lanes(tris, i);
+        store4(inside4(t, area4(t), vx, vy), out + i);
+    }
+#endif
+    for (; i < end; i++) {
+        out[i] = point_in_tri(px, py, tris.get(i));
+    }
+}
+
+void tri_in_tris(const Triangles& tris, size_t begin, size_t end, const Tri& q, uint8_t *out)
+{
+    size_t i = begin;
+#ifdef GEOM_SSE2
+    for (; i + 4 <= end; i += 4) {
+        store4(contains4(Lanes(tris, i), q), out + i);
+    }
+#endif
+    for (; i < end; i++) {
+        out[i] = tri_in_tri(q, tris.get(i));
+    }
+}
+
+void tri_overlaps(const Triangles& tris, size_t begin, size_t end, const Tri& q, uint8_t *out)
+{
+    int32_t q_area = orient(q.x0, q.y0, q.x1, q.y1, q.x2, q.y2);
+    size_t i = begin;
+#ifdef GEOM_SSE2
+    if (q_area == 0) {
+        for (; i < end; i++) {
+            out[i] = 0;
+        }
+        return;
+    }
+    __m128i zero = _mm_setzero_si128();
+    __m128i qx[3] = { _mm_set1_epi32(q.x0), _mm_set1_epi32(q.x1), _mm_set1_epi32(q.x2) };
+    __m128i qy[3] = { _mm_set1_epi32(q.y0), _mm_set1_epi32(q.y1), _mm_set1_epi32(q.y2) };
+    for (; i + 4 <= end; i += 4) {
+        Lanes t = Lanes(tris, i);
+        __m128i area = area4(t);
+        __m128i ccw = _mm_cmpgt_epi32(area, zero);
+        __m128i cw = _mm_cmplt_epi32(area, zero);
+        __m128i tx[3] = { t.x0, t.x1, t.x2 };
+        __m128i ty[3] = { t.y0, t.y1, t.y2 };
+        __m128i separated = zero;
+        for (int e = 0; e < 3; e++) {
+            int n = (e + 1) % 3;
+            // q's vertices against the triangles' edges
+            __m128i o0 = orient4(tx[e], ty[e], tx[n], ty[n], qx[0], qy[0]);
+            __m128i o1 = orient4(tx[e], ty[e], tx[n], ty[n], qx[1], qy[1]);
+            __m128i o2 = orient4(tx[e], ty[e], tx[n], ty[n], qx[2], qy[2]);
+            __m128i all_neg = _mm_and_si128(_mm_and_si128(_mm_cmplt_epi32(o0, zero), _mm_cmplt_epi32(o1, zero)), _mm_cmplt_epi32(o2, zero));
+            __m128i all_pos = _mm_and_si128(_mm_and_si128(_mm_cmpgt_epi32(o0, zero), _mm_cmpgt_epi32(o1, zero)), _mm_cmpgt_epi32(o2, zero));
+            separated = _mm_or_si128(separated, _mm_or_si128(_mm_and_si128(ccw, all_neg), _mm_and_si128(cw, all_pos)));
+
+            // the triangles' vertices against q's edges
+            o0 = orient4(qx[e], qy[e], qx[n], qy[n], t.x0, t.y0);
+            o1 = orient4(qx[e], qy[e], qx[n], qy[n], t.x1, t.y1);
+            o2 = orient4(qx[e], qy[e], qx[n], qy[n], t.x2, t.y2);
+            if (q_area > 0)
+                separated = _mm_or_si128(separated, _mm_and_si128(_mm_and_si128(_mm_cmplt_epi32(o0, zero), _mm_cmplt_epi32(o1, zero)), _mm_cmplt_epi32(o2, zero)));
+            else
+                separated = _mm_or_si128(separated, _mm_and_si128(_mm_and_si128(_mm_cmpgt_epi32(o0, zero), _mm_cmpgt_epi32(o1, zero)), _mm_cmpgt_epi32(o2, zero)));
+        }
+        __m128i flat = _mm_cmpeq_epi32(area, zero);
+        store4(_mm_andnot_si128(_mm_or_si128(separated, flat), _mm_set1_epi32(-1)), out + i);
+    }
+#endif
+    for (; i < end; i++) {
+        out[i] = tri_overlap(q, tris.get(i));
+    }
+}
+
+size_t find_containing(const Triangles& tris, size_t begin, size_t end, const Tri& q)
+{
+    size_t i = begin;
+#ifdef GEOM_SSE2
+    for (; i + 4 <= end; i += 4) {
+        int bits = _mm_movemask_ps(_mm_castsi128_ps(contains4(Lanes(tris, i), q)));
+        if (bits)
+            return i + __builtin_ctz(bits);
+    }
+#endif
+    for (; i < end; i++) {
+        if (tri_in_tri(q, tris.get(i)))
+            return i;
+    }
+    return end;
+}
+
+} // geom
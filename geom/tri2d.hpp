@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace geom {
+
+/******************************************************************************
+ * 2D Triangle Kernels
+ *
+ * Containment and overlap tests between integer points and triangles, run
+ * over whole arrays at once. Triangles are kept as structure of arrays so the
+ * same coordinate of consecutive triangles sits together and four of them go
+ * through each SSE2 step, with a scalar path when that isn't available.
+ *
+ * Every decision comes from the sign of an exact orientation. Coordinates are
+ * limited to +-COORD_LIMIT so edge vectors fit in 16 bits and orientations in
+ * 32, exact in either path, and the SSE2 path gets each orientation from one
+ * 16 bit multiply-add. Points on an edge count as inside, triangles with zero
+ * area contain and overlap nothing, and either winding is accepted.
+ */
+
+constexpr int32_t COORD_LIMIT = 1 << 14;
+
+struct Tri {
+    int32_t x0, y0, x1, y1, x2, y2;
+};
+
+struct Triangles {
+    std::vector<int32_t> x0, y0, x1, y1, x2, y2;
+
+    void clear();
+    void push(const Tri& t);
+    size_t size() const { return x0.size(); }
+    Tri get(size_t i) const;
+};
+
+// twice the signed area of a, b, c: positive when c is left of a -> b
+inline int32_t orient(int32_t ax, int32_t ay, int32_t bx, int32_t by, int32_t cx, int32_t cy)
+{
+    return (bx - ax) * (cy - ay) - (by - ay) * (cx - ax);
+}
+
+bool point_in_tri(int32_t px, int32_t py, const Tri& t);
+// all of a inside b
+bool tri_in_tri(const Tri& a, const Tri& b);
+// a and b share at least one point
+bool tri_overlap(const Tri& a, const Tri& b);
+
+// the batched versions write out[i] for every i in [begin, end) of tris
+// point (px, py) inside tris[i]
+void points_in_tris(const Triangles& tris, size_t begin, size_t end, int32_t px, int32_t py, uint8_t *out);
+// q entirely inside tris[i]
+void tri_in_tris(const Triangles& tris, size_t begin, size_t end, const Tri& q, uint8_t *out);
+// q shares at least one point with tris[i]
+void tri_overlaps(const Triangles& tris, size_t begin, size_t end, const Tri& q, uint8_t *out);
+// first i in [begin, end) with q entirely inside tris[i], or end
+size_t find_containing(const Triangles& tris, size_t begin, size_t end, const Tri& q);
+
+} // geom
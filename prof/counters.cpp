@@ -0,0 +1,238 @@
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include "counters.hpp"
+
+namespace prof {
+
+constexpr int SCOPES_MAX = 64;
+
+struct ScopeTotals {
+    const char *name;
+    uint64_t calls;
+    uint64_t ns;
+    uint64_t counts[COUNTER_COUNT];
+    uint64_t counted_calls[COUNTER_COUNT]; // calls the counter was read for
+};
+
+// counters opened as one group on the thread that first needs them
+struct Group {
+    bool tried = false;
+    int leader = -1;
+    int fds[COUNTER_COUNT];
+    int slot[COUNTER_COUNT]; // position in a group read, -1 if it didn't open
+
+    ~Group() {
+#ifdef __linux__
+        for (int c = 0; c < COUNTER_COUNT; c++) {
+            if (this->tried && this->fds[c] >= 0)
+                close(this->fds[c]);
+        }
+#endif
+    }
+};
+
+static std::mutex Mutex;
+static ScopeTotals Scopes[SCOPES_MAX];
+static int ScopeCount = 0;
+static bool Warned = false;
+static std::atomic<int> Enabled{ -1 }; // -1 until the environment is checked
+static thread_local Group Counters;
+
+static uint64_t now_ns()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+#ifdef __linux__
+static int open_counter(uint32_t type, uint64_t config, int group)
+{
+    perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = type;
+    attr.config = config;
+    // the leader starts stopped and the whole group is enabled together
+    attr.disabled = group == -1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_GROUP;
+    return (int)syscall(SYS_perf_event_open, &attr, 0, -1, group, 0);
+}
+#endif
+
+static void group_open(Group& g)
+{
+    g.tried = true;
+    for (int c = 0; c < COUNTER_COUNT; c++) {
+        g.fds[c] = -1;
+        g.slot[c] = -1;
+    }
+    int error = ENOSYS;
+#ifdef __linux__
+    const struct { uint32_t type; uint64_t config; } events[COUNTER_COUNT] = {
+        { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+        { PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+        { PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16) },
+        { PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_LL | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16) },
+        { PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES },
+    };
+    // whichever opens first leads, the rest are skipped if they don't exist here
+    int opened = 0;
+    for (int c = 0; c < COUNTER_COUNT; c++) {
+        int fd = open_counter(events[c].type, events[c].config, g.leader);
+        if (fd < 0) {
+            error = errno;
+            continue;
+        }
+        if (g.leader == -1)
+            g.leader = fd;
+        g.fds[c] = fd;
+        g.slot[c] = opened++;
+    }
+    if (g.leader != -1) {
+        ioctl(g.leader, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+        ioctl(g.leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+        return;
+    }
+#endif
+    std::lock_guard<std::mutex> lock(Mutex);
+    if (!Warned) {
+        fprintf(stderr, "Warning: Hardware counters unavailable (%s), scopes report time only\n", strerror(error));
+        Warned = true;
+    }
+}
+
+static bool group_read(Group& g, uint64_t out[COUNTER_COUNT])
+{
+    if (!g.tried)
+        group_open(g);
+    if (g.leader == -1)
+        return false;
+#ifdef __linux__
+    uint64_t values[1 + COUNTER_COUNT];
+    if (read(g.leader, values, sizeof(values)) < (ssize_t)sizeof(uint64_t))
+        return false;
+    for (int c = 0; c < COUNTER_COUNT; c++) {
+        out[c] = g.slot[c] >= 0 ? values[1 + g.slot[c]] : 0;
+    }
+    return true;
+#else
+    return false;
+#endif
+}
+
+CounterScope::CounterScope(const char *name) : name(name), active(counters_enabled()), counted(false), start_ns(0)
+{
+    if (!this->active)
+        return;
+    this->counted = group_read(Counters, this->start);
+    this->start_ns = now_ns();
+}
+
+CounterScope::~CounterScope()
+{
+    if (!this->active)
+        return;
+    uint64_t end_ns = now_ns();
+    uint64_t end[COUNTER_COUNT];
+    bool counted = this->counted && group_read(Counters, end);
+
+    std::lock_guard<std::mutex> lock(Mutex);
+    ScopeTotals *scope = nullptr;
+    for (int i = 0; i < ScopeCount; i++) {
+        if (Scopes[i].name == this->name || strcmp(Scopes[i].name, this->name) == 0) {
+            scope = &Scopes[i];
+            break;
+        }
+    }
+    if (!scope) {
+        if (ScopeCount == SCOPES_MAX)
+            return;
+        scope = &Scopes[ScopeCount++];
+        memset(scope, 0, sizeof(*scope));
+        scope->name = this->name;
+    }
+    scope->calls += 1;
+    scope->ns += end_ns - this->start_ns;
+    if (!counted)
+        return;
+    for (int c = 0; c < COUNTER_COUNT; c++) {
+        if (Counters.slot[c] < 0)
+            continue;
+        scope->counts[c] += end[c] - this->start[c];
+        scope->counted_calls[c] += 1;
+    }
+}
+
+void counters_enable(bool enable)
+{
+    Enabled = enable;
+}
+
+bool counters_enabled()
+{
+    int enabled = Enabled;
+    if (enabled < 0) {
+        enabled = getenv("PSE_PERF_COUNTERS") != nullptr;
+        Enabled = enabled;
+    }
+    return enabled;
+}
+
+// per call average of a counter, or n/a
+static const char *average(char *buffer, size_t size, const ScopeTotals& scope, Counter c)
+{
+    if (scope.counted_calls[c] == 0)
+        snprintf(buffer, size, "n/a");
+    else
+        snprintf(buffer, size, "%.0f", (double)scope.counts[c] / scope.counted_calls[c]);
+    return buffer;
+}
+
+void counters_report()
+{
+    std::lock_guard<std::mutex> lock(Mutex);
+    if (ScopeCount == 0) {
+        printf("counters: nothing recorded%s\n", Enabled == 1 ? "" : ", not enabled (PSE_PERF_COUNTERS)");
+        return;
+    }
+    printf("%-20s %8s %10s %12s %12s %6s %10s %10s %10s\n",
+        "scope", "calls", "ms/call", "cycles", "instr", "IPC", "L1D miss", "LLC miss", "br miss");
+    for (int i = 0; i < ScopeCount; i++) {
+        ScopeTotals& s = Scopes[i];
+        char cycles[32], instructions[32], l1d[32], llc[32], branches[32], ipc[32];
+        if (s.counted_calls[CYCLES] && s.counted_calls[INSTRUCTIONS] && s.counts[CYCLES])
+            snprintf(ipc, sizeof(ipc), "%.2f", (double)s.counts[INSTRUCTIONS] / s.counts[CYCLES]);
+        else
+            snprintf(ipc, sizeof(ipc), "n/a");
+        printf("%-20s %8llu %10.4f %12s %12s %6s %10s %10s %10s\n",
+            s.name, (unsigned long long)s.calls, s.ns / 1e6 / s.calls,
+            average(cycles, sizeof(cycles), s, CYCLES),
+            average(instructions, sizeof(instructions), s, INSTRUCTIONS), ipc,
+            average(l1d, sizeof(l1d), s, L1D_MISSES),
+            average(llc, sizeof(llc), s, LLC_MISSES),
+            average(branches, sizeof(branches), s, BRANCH_MISSES));
+    }
+}
+
+void counters_reset()
+{
+    std::lock_guard<std::mutex> lock(Mutex);
+    ScopeCount = 0;
+}
+
+} // prof
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstdint>
+
+namespace prof {
+
+/******************************************************************************
+ * Hardware Counters
+ *
+ * Scoped timing plus cycles, instructions, L1D and LLC read misses and
+ * branch misses from Linux perf_event_open, summed per named scope. Off
+ * unless PSE_PERF_COUNTERS is set in the environment or counters_enable()
+ * is called, a disabled scope costs one branch. Counters the kernel or
+ * hardware won't give us (other platforms, perf_event_paranoid, VMs) read as
+ * unavailable and the scopes keep reporting wall time.
+ *
+ * Counters follow the thread that opens a scope, so scopes on worker threads
+ * measure the worker.
+ */
+
+enum Counter {
+    CYCLES,
+    INSTRUCTIONS,
+    L1D_MISSES,
+    LLC_MISSES,
+    BRANCH_MISSES,
+    COUNTER_COUNT,
+};
+
+struct CounterScope {
+    const char *name;
+    bool active;
+    bool counted; // counters were readable at the start
+    uint64_t start[COUNTER_COUNT];
+    uint64_t start_ns;
+
+    // name must outlive the program, a string literal
+    explicit CounterScope(const char *name);
+    ~CounterScope();
+};
+
+void counters_enable(bool enable);
+bool counters_enabled();
+// print every scope's per call averages since the last reset
+void counters_report();
+void counters_reset();
+
+} // prof
+
+#ifndef PROF_CONCAT
+#define PROF_CONCAT_(a, b) a##b
+#define PROF_CONCAT(a, b) PROF_CONCAT_(a, b)
+#endif
+// count the rest of the enclosing block as scope name
+#define PROF_COUNTERS(name) prof::CounterScope PROF_CONCAT(prof_counters_, __LINE__)(name)
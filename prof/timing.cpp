@@ -0,0 +1,222 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+
+#include "timing.hpp"
+
+namespace prof {
+
+constexpr int MODULES_MAX = 16;
+constexpr int HISTOGRAM_SUB = 1 << HISTOGRAM_SUB_BITS;
+
+struct Module {
+    const char *name;
+    double budget_ms;
+    uint64_t frames;
+    uint64_t overruns;
+    Histogram histogram;
+};
+
+static std::mutex Mutex;
+static Module Modules[MODULES_MAX];
+static int ModuleCount = 0;
+static OverrunCallback Callback = nullptr;
+
+/******************************************************************************
+ * Histogram
+ */
+
+// values below HISTOGRAM_SUB get a bucket each, above that every power of
+// two is split into HISTOGRAM_SUB buckets
+static int bucket_index(uint64_t value)
+{
+    if (value < HISTOGRAM_SUB)
+        return (int)value;
+    int exponent = 63 - __builtin_clzll(value);
+    int shift = exponent - HISTOGRAM_SUB_BITS;
+    int sub = (int)(value >> shift) & (HISTOGRAM_SUB - 1);
+    return ((shift + 1) << HISTOGRAM_SUB_BITS) + sub;
+}
+
+// largest value landing in a bucket
+static uint64_t bucket_high(int index)
+{
+    int group = index >> HISTOGRAM_SUB_BITS;
+    uint64_t sub = index & (HISTOGRAM_SUB - 1);
+    if (group == 0)
+        return sub;
+    int shift = group - 1;
+    return ((HISTOGRAM_SUB + sub) << shift) + (((uint64_t)1 << shift) - 1);
+}
+
+void Histogram::record(uint64_t value)
+{
+    this->counts[bucket_index(value)] += 1;
+    this->total += 1;
+    this->sum += value;
+    if (value > this->max)
+        this->max = value;
+}
+
+uint64_t Histogram::percentile(double p) const
+{
+    if (this->total == 0)
+        return 0;
+    uint64_t target = (uint64_t)std::ceil(p * this->total);
+    if (target < 1)
+        target = 1;
+    uint64_t seen = 0;
+    for (int i = 0; i < HISTOGRAM_BUCKETS; i++) {
+        seen += this->counts[i];
+        if (seen >= target)
+            return std::min(bucket_high(i), this->max);
+    }
+    return this->max;
+}
+
+void Histogram::reset()
+{
+    memset(this, 0, sizeof(*this));
+}
+
+/******************************************************************************
+ * Modules
+ */
+
+static void report_at_exit()
+{
+    modules_report();
+}
+
+// caller holds Mutex
+static int module_find(const char *name, bool add)
+{
+    for (int i = 0; i < ModuleCount; i++) {
+        if (Modules[i].name == name || strcmp(Modules[i].name, name) == 0)
+            return i;
+    }
+    if (!add)
+        return -1;
+    if (ModuleCount == MODULES_MAX) {
+        fprintf(stderr, "Error: More than %d timed modules, %s isn't tracked\n", MODULES_MAX, name);
+        return -1;
+    }
+    if (ModuleCount == 0)
+        std::atexit(report_at_exit);
+    Module& module = Modules[ModuleCount];
+    memset(&module, 0, sizeof(module));
+    module.name = name;
+    module.budget_ms = MODULE_BUDGET_MS;
+    return ModuleCount++;
+}
+
+static uint64_t now_ns()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+ModuleScope::ModuleScope(const char *name)
+{
+    {
+        std::lock_guard<std::mutex> lock(Mutex);
+        this->module = module_find(name, true);
+    }
+    this->start_ns = now_ns();
+}
+
+ModuleScope::~ModuleScope()
+{
+    uint64_t ns = now_ns() - this->start_ns;
+    if (this->module < 0)
+        return;
+
+    OverrunCallback callback;
+    const char *name;
+    uint64_t frame;
+    double budget_ms;
+    double ms = ns / 1e6;
+    {
+        std::lock_guard<std::mutex> lock(Mutex);
+        Module& module = Modules[this->module];
+        module.histogram.record(ns);
+        frame = module.frames++;
+        if (ms <= module.budget_ms)
+            return;
+        module.overruns += 1;
+        callback = Callback;
+        name = module.name;
+        budget_ms = module.budget_ms;
+    }
+    // outside the lock, the callback may well query the stats
+    if (callback)
+        callback(name, frame, ms, budget_ms);
+    else
+        fprintf(stderr, "Warning: %s update took %.2f ms at frame %llu, over its %.2f ms budget\n",
+            name, ms, (unsigned long long)frame, budget_ms);
+}
+
+void module_budget(const char *name, double ms)
+{
+    std::lock_guard<std::mutex> lock(Mutex);
+    int i = module_find(name, true);
+    if (i >= 0)
+        Modules[i].budget_ms = ms;
+}
+
+void module_overrun_callback(OverrunCallback callback)
+{
+    std::lock_guard<std::mutex> lock(Mutex);
+    Callback = callback;
+}
+
+bool module_stats(const char *name, ModuleStats *out)
+{
+    std::lock_guard<std::mutex> lock(Mutex);
+    int i = module_find(name, false);
+    if (i < 0 || Modules[i].frames == 0)
+        return false;
+    Module& module = Modules[i];
+    Histogram& h = module.histogram;
+    out->frames = module.frames;
+    out->overruns = module.overruns;
+    out->budget_ms = module.budget_ms;
+    out->mean_ms = (double)h.sum / h.total / 1e6;
+    out->p50_ms = h.percentile(0.5) / 1e6;
+    out->p99_ms = h.percentile(0.99) / 1e6;
+    out->max_ms = h.max / 1e6;
+    return true;
+}
+
+void modules_report()
+{
+    std::lock_guard<std::mutex> lock(Mutex);
+    printf("%-10s %8s %10s %10s %10s %10s %10s %9s\n",
+        "module", "frames", "mean ms", "p50 ms", "p99 ms", "max ms", "budget ms", "overruns");
+    for (int i = 0; i < ModuleCount; i++) {
+        Module& module = Modules[i];
+        Histogram& h = module.histogram;
+        if (h.total == 0)
+            continue;
+        printf("%-10s %8llu %10.3f %10.3f %10.3f %10.3f %10.2f %9llu\n",
+            module.name, (unsigned long long)module.frames, (double)h.sum / h.total / 1e6,
+            h.percentile(0.5) / 1e6, h.percentile(0.99) / 1e6, h.max / 1e6,
+            module.budget_ms, (unsigned long long)module.overruns);
+    }
+}
+
+void modules_reset()
+{
+    std::lock_guard<std::mutex> lock(Mutex);
+    for (int i = 0; i < ModuleCount; i++) {
+        Modules[i].frames = 0;
+        Modules[i].overruns = 0;
+        Modules[i].histogram.reset();
+    }
+}
+
+} // prof
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cstdint>
+
+namespace prof {
+
+/******************************************************************************
+ * Module Timing
+ *
+ * Per module accounting of whole update calls. Every call lands in a log
+ * linear histogram, buckets 1/16th of a power of two wide, so percentiles are
+ * within about 6% at any scale from nanoseconds to seconds without storing
+ * samples. Each module has a frame budget, a call over it is reported with
+ * the module's frame number to the overrun callback, or logged without one.
+ *
+ * Every module's histogram is printed when the program exits.
+ */
+
+constexpr double MODULE_BUDGET_MS = 16.0;
+constexpr int HISTOGRAM_SUB_BITS = 4;
+constexpr int HISTOGRAM_BUCKETS = (64 - HISTOGRAM_SUB_BITS + 1) << HISTOGRAM_SUB_BITS;
+
+struct Histogram {
+    uint64_t counts[HISTOGRAM_BUCKETS];
+    uint64_t total;
+    uint64_t sum;
+    uint64_t max;
+
+    void record(uint64_t value);
+    // smallest value at or above fraction p of the samples, to bucket precision
+    uint64_t percentile(double p) const;
+    void reset();
+};
+
+struct ModuleStats {
+    uint64_t frames;
+    uint64_t overruns;
+    double budget_ms;
+    double mean_ms;
+    double p50_ms;
+    double p99_ms;
+    double max_ms;
+};
+
+using OverrunCallback = void (*)(const char *module, uint64_t frame, double ms, double budget_ms);
+
+// name must outlive the program, a string literal
+void module_budget(const char *name, double ms);
+// replaces the log line, nullptr goes back to logging
+void module_overrun_callback(OverrunCallback callback);
+// false if the module never ran
+bool module_stats(const char *name, ModuleStats *out);
+void modules_report();
+void modules_reset();
+
+struct ModuleScope {
+    int module;
+    uint64_t start_ns;
+
+    explicit ModuleScope(const char *name);
+    ~ModuleScope();
+};
+
+} // prof
+
+#ifndef PROF_CONCAT
+#define PROF_CONCAT_(a, b) a##b
+#define PROF_CONCAT(a, b) PROF_CONCAT_(a, b)
+#endif
+// account the rest of the enclosing block, a module's update, to name
+#define PROF_MODULE(name) prof::ModuleScope PROF_CONCAT(prof_module_, __LINE__)(name)
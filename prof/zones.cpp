@@ -0,0 +1,158 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <mutex>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define PROF_TSC 1
+#elif defined(_M_X64)
+#include <intrin.h>
+#define PROF_TSC 1
+#endif
+
+#include "zones.hpp"
+
+namespace prof {
+
+static_assert((ZONE_RING_SIZE & (ZONE_RING_SIZE - 1)) == 0, "ring index is masked");
+
+// fields are relaxed atomics so a dump can read a ring while its thread writes
+struct ZoneEvent {
+    std::atomic<const char *> name;
+    std::atomic<uint64_t> start;
+    std::atomic<uint64_t> end;
+};
+
+struct Ring {
+    std::atomic<uint64_t> head{ 0 }; // zones ever recorded, the next slot
+    std::atomic<const char *> thread_name{ nullptr };
+    int tid = 0;
+    ZoneEvent events[ZONE_RING_SIZE];
+};
+
+static uint64_t steady_ns()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+uint64_t zone_clock()
+{
+#ifdef PROF_TSC
+    return __rdtsc();
+#else
+    return steady_ns();
+#endif
+}
+
+// both clocks at startup, dumps measure the tick rate against them
+struct Epoch {
+    uint64_t ticks;
+    uint64_t ns;
+};
+
+static const Epoch Start = Epoch{ zone_clock(), steady_ns() };
+static std::mutex Mutex;
+static std::vector<Ring *> Rings;
+static thread_local Ring *ThreadRing = nullptr;
+
+static Ring *thread_ring()
+{
+    if (ThreadRing)
+        return ThreadRing;
+    // never freed, the ring outlives the thread so its zones still dump
+    Ring *ring = new Ring;
+    std::lock_guard<std::mutex> lock(Mutex);
+    ring->tid = (int)Rings.size() + 1;
+    Rings.push_back(ring);
+    ThreadRing = ring;
+    return ring;
+}
+
+void zone_record(const char *name, uint64_t start, uint64_t end)
+{
+    Ring *ring = thread_ring();
+    uint64_t head = ring->head.load(std::memory_order_relaxed);
+    ZoneEvent& event = ring->events[head & (ZONE_RING_SIZE - 1)];
+    event.name.store(name, std::memory_order_relaxed);
+    event.start.store(start, std::memory_order_relaxed);
+    event.end.store(end, std::memory_order_relaxed);
+    ring->head.store(head + 1, std::memory_order_release);
+}
+
+void zone_thread_name(const char *name)
+{
+    thread_ring()->thread_name.store(name, std::memory_order_relaxed);
+}
+
+bool zones_dump(const char *path, double seconds)
+{
+    FILE *file = fopen(path, "w");
+    if (!file) {
+        fprintf(stderr, "Error: Couldn't open %s for writing zones\n", path);
+        return false;
+    }
+
+    uint64_t now = zone_clock();
+    uint64_t now_ns = steady_ns();
+    double ticks_per_us = 1000.0;
+    if (now_ns > Start.ns && now > Start.ticks)
+        ticks_per_us = (double)(now - Start.ticks) / (now_ns - Start.ns) * 1000.0;
+    double window = seconds * 1e6 * ticks_per_us;
+    uint64_t cutoff = (double)(now - Start.ticks) > window ? now - (uint64_t)window : Start.ticks;
+
+    std::vector<Ring *> rings;
+    {
+        std::lock_guard<std::mutex> lock(Mutex);
+        rings = Rings;
+    }
+
+    fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    fprintf(file, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"pse\"}}");
+    int written = 0;
+    struct Copy { const char *name; uint64_t start, end; };
+    std::vector<Copy> copies;
+    for (Ring *ring : rings) {
+        const char *thread_name = ring->thread_name.load(std::memory_order_relaxed);
+        if (thread_name) {
+            fprintf(file, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+                ring->tid, thread_name);
+        }
+
+        uint64_t head = ring->head.load(std::memory_order_acquire);
+        uint64_t begin = head > ZONE_RING_SIZE ? head - ZONE_RING_SIZE : 0;
+        copies.clear();
+        for (uint64_t i = begin; i < head; i++) {
+            ZoneEvent& event = ring->events[i & (ZONE_RING_SIZE - 1)];
+            copies.push_back(Copy{
+                event.name.load(std::memory_order_relaxed),
+                event.start.load(std::memory_order_relaxed),
+                event.end.load(std::memory_order_relaxed),
+            });
+        }
+        // the thread kept recording while we copied, drop the slots it may
+        // have lapped, including the one it could be halfway through
+        std::atomic_thread_fence(std::memory_order_acquire);
+        uint64_t after = ring->head.load(std::memory_order_relaxed);
+        uint64_t valid = after + 1 > ZONE_RING_SIZE ? after + 1 - ZONE_RING_SIZE : 0;
+
+        for (uint64_t i = std::max(begin, valid); i < head; i++) {
+            Copy& zone = copies[i - begin];
+            if (zone.start < cutoff || zone.end < zone.start)
+                continue;
+            fprintf(file, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",
+                zone.name, ring->tid,
+                (zone.start - Start.ticks) / ticks_per_us, (zone.end - zone.start) / ticks_per_us);
+            written++;
+        }
+    }
+    fprintf(file, "\n]}\n");
+    fclose(file);
+    printf("Wrote %d zones from %zu threads to %s\n", written, rings.size(), path);
+    return true;
+}
+
+} // prof
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstdint>
+
+namespace prof {
+
+/******************************************************************************
+ * Zones
+ *
+ * Named begin/end spans recorded into a fixed ring per thread and written out
+ * as Chrome trace-event JSON, which Perfetto and chrome://tracing open. A
+ * zone is two timestamp reads and one store into the calling thread's ring,
+ * no locks or allocation after the thread's first zone. Old zones are
+ * overwritten once a ring wraps, so a dump holds at most the last
+ * ZONE_RING_SIZE zones of each thread.
+ *
+ * Rings outlive their threads so a finished worker's zones still dump.
+ */
+
+constexpr int ZONE_RING_SIZE = 1 << 16;
+// how far back the modules' dump keys reach
+constexpr double ZONE_DUMP_SECONDS = 5.0;
+
+// raw timestamp, the TSC on x86 and steady_clock nanoseconds elsewhere
+uint64_t zone_clock();
+// name must outlive the program, a string literal
+void zone_record(const char *name, uint64_t start, uint64_t end);
+// label the calling thread in dumps
+void zone_thread_name(const char *name);
+// write the last seconds of every thread's zones to path, false on failure
+bool zones_dump(const char *path, double seconds);
+
+struct Zone {
+    const char *name;
+    uint64_t start;
+
+    explicit Zone(const char *name) : name(name), start(zone_clock()) {}
+    ~Zone() { zone_record(this->name, this->start, zone_clock()); }
+};
+
+} // prof
+
+#ifndef PROF_CONCAT
+#define PROF_CONCAT_(a, b) a##b
+#define PROF_CONCAT(a, b) PROF_CONCAT_(a, b)
+#endif
+// record the rest of the enclosing block as a zone
+#define PROF_ZONE(name) prof::Zone PROF_CONCAT(prof_zone_, __LINE__)(name)
@@ -0,0 +1,264 @@
+#include <algorithm>
+#include <cstdio>
+#include <utility>
+#include <vector>
+
+#include "../../pse.hpp"
+#include "../prof/zones.hpp"
+#include "cave.hpp"
+#include "gen.hpp"
+#include "globals.hpp"
+#include "types.hpp"
+
+namespace Modules {
+
+static const int StepI[NEIGHBORS_MAX] = { -1, 0, 1, 0 };
+static const int StepJ[NEIGHBORS_MAX] = { 0, 1, 0, -1 };
+
+// horizontal sums for the automaton, a 2 bit count per tile as two planes
+static thread_local std::vector<uint64_t> CaveSums;
+static thread_local std::vector<int> CaveQueue;
+
+static void cave_border(BitGrid& rock)
+{
+    uint64_t last = 1ull << ((rock.width - 1) & 63);
+    for (int w = 0; w < rock.words; ++w) {
+        rock.row(0)[w] = ~0ull;
+        rock.row(rock.height - 1)[w] = ~0ull;
+    }
+    for (int i = 1; i < rock.height - 1; ++i) {
+        rock.row(i)[0] |= 1;
+        rock.row(i)[rock.words - 1] |= last;
+    }
+}
+
+void cave_seed(BitGrid& rock, int fill, Rng& rng)
+{
+    uint64_t padding = rock.padding();
+    for (int i = 0; i < rock.height; ++i) {
+        uint64_t *row = rock.row(i);
+        for (int w = 0; w < rock.words; ++w) {
+            // 4 random words give every bit a number below 16, compared against fill a bit at a time
+            uint64_t below = 0;
+            uint64_t equal = ~0ull;
+            for (int b = 3; b >= 0; --b) {
+                uint64_t r = rng.next();
+                if (fill >> b & 1) {
+                    below |= equal & ~r;
+                    equal &= r;
+                }
+                else {
+                    equal &= ~r;
+                }
+            }
+            row[w] = below;
+        }
+        row[rock.words - 1] |= padding;
+    }
+    cave_border(rock);
+}
+
+// each tile plus its left and right neighbor, tiles off the map count as rock
+static void row_sums(const uint64_t *row, int words, uint64_t *ones, uint64_t *twos)
+{
+    for (int w = 0; w < words; ++w) {
+        uint64_t prev = w > 0 ? row[w - 1] : ~0ull;
+        uint64_t next = w + 1 < words ? row[w + 1] : ~0ull;
+        uint64_t c = row[w];
+        uint64_t l = c << 1 | prev >> 63;
+        uint64_t r = c >> 1 | next << 63;
+        ones[w] = l ^ c ^ r;
+        twos[w] = (l & c) | (r & (l ^ c));
+    }
+}
+
+void cave_step(const BitGrid& rock, BitGrid& out)
+{
+    PROF_ZONE("cave_step");
+    int words = rock.words;
+    if (out.width != rock.width || out.height != rock.height)
+        out.resize(rock.width, rock.height, true);
+
+    // rows above, at and below the one being stepped, the row above the map is all rock (3 of 3)
+    CaveSums.resize((size_t)words * 6);
+    uint64_t *ones[3], *twos[3];
+    for (int k = 0; k < 3; ++k) {
+        ones[k] = &CaveSums[(size_t)words * 2 * k];
+        twos[k] = ones[k] + words;
+    }
+    std::fill(ones[0], ones[0] + words, ~0ull);
+    std::fill(twos[0], twos[0] + words, ~0ull);
+    row_sums(rock.row(0), words, ones[1], twos[1]);
+
+    uint64_t padding = rock.padding();
+    for (int i = 0; i < rock.height; ++i) {
+        if (i + 1 < rock.height) {
+            row_sums(rock.row(i + 1), words, ones[2], twos[2]);
+        }
+        else {
+            std::fill(ones[2], ones[2] + words, ~0ull);
+            std::fill(twos[2], twos[2] + words, ~0ull);
+        }
+
+        // add three 2 bit counts into a 4 bit count with full adders, 64 tiles at a time
+        const uint64_t *a0 = ones[0], *a1 = twos[0];
+        const uint64_t *b0 = ones[1], *b1 = twos[1];
+        const uint64_t *c0 = ones[2], *c1 = twos[2];
+        uint64_t *dst = out.row(i);
+        for (int w = 0; w < words; ++w) {
+            uint64_t s0 = a0[w] ^ b0[w] ^ c0[w];
+            uint64_t k0 = (a0[w] & b0[w]) | (c0[w] & (a0[w] ^ b0[w]));
+            uint64_t t = a1[w] ^ b1[w] ^ c1[w];
+            uint64_t k1 = (a1[w] & b1[w]) | (c1[w] & (a1[w] ^ b1[w]));
+            uint64_t s1 = t ^ k0;
+            uint64_t k2 = t & k0;
+            uint64_t s2 = k1 ^ k2;
+            uint64_t s3 = k1 & k2;
+            // 5 or more of the 9
+            dst[w] = s3 | (s2 & (s1 | s0));
+        }
+        dst[words - 1] |= padding;
+
+        std::swap(ones[0], ones[1]);
+        std::swap(twos[0], twos[1]);
+        std::swap(ones[1], ones[2]);
+        std::swap(twos[1], twos[2]);
+    }
+    cave_border(out);
+}
+
+// marks the open tiles connected to start in region, returns how many
+static int cave_fill(const BitGrid& rock, BitGrid& region, int start_i, int start_j)
+{
+    CaveQueue.clear();
+    CaveQueue.push_back(start_i * rock.width + start_j);
+    region.set(start_i, start_j, true);
+    for (size_t head = 0; head < CaveQueue.size(); ++head) {
+        int i = CaveQueue[head] / rock.width;
+        int j = CaveQueue[head] % rock.width;
+        // the border is rock, so neighbors of an open tile are on the map
+        for (int k = 0; k < NEIGHBORS_MAX; ++k) {
+            int ni = i + StepI[k];
+            int nj = j + StepJ[k];
+            if (rock.get(ni, nj) || region.get(ni, nj))
+                continue;
+            region.set(ni, nj, true);
+            CaveQueue.push_back(ni * rock.width + nj);
+        }
+    }
+    return (int)CaveQueue.size();
+}
+
+int cave_keep_largest(const BitGrid& rock, BitGrid& open)
+{
+    BitGrid seen;
+    seen.resize(rock.width, rock.height, false);
+    int best = 0, best_i = 0, best_j = 0;
+    for (int i = 0; i < rock.height; ++i) {
+        for (int w = 0; w < rock.words; ++w) {
+            // padding is rock, never a candidate
+            uint64_t candidates;
+            while ((candidates = ~rock.row(i)[w] & ~seen.row(i)[w]) != 0) {
+                int j = w * 64 + __builtin_ctzll(candidates);
+                int size = cave_fill(rock, seen, i, j);
+                if (size > best) {
+                    best = size;
+                    best_i = i;
+                    best_j = j;
+                }
+            }
+        }
+    }
+
+    open.resize(rock.width, rock.height, false);
+    if (best > 0)
+        cave_fill(rock, open, best_i, best_j);
+    CaveQueue.clear();
+    CaveQueue.shrink_to_fit();
+    return best;
+}
+
+// the nth open tile in row major order
+static void cave_tile(const BitGrid& open, int n, int *i, int *j)
+{
+    for (*i = 0; *i < open.height; ++*i) {
+        const uint64_t *row = open.row(*i);
+        for (int w = 0; w < open.words; ++w) {
+            uint64_t word = row[w];
+            int count = __builtin_popcountll(word);
+            if (n >= count) {
+                n -= count;
+                continue;
+            }
+            while (n-- > 0)
+                word &= word - 1;
+            *j = w * 64 + __builtin_ctzll(word);
+            return;
+        }
+    }
+    fprintf(stderr, "Error: Cave has no open tile %d\n", n);
+    exit(-1);
+}
+
+void gen_caves(Floor& floor, Rng& rng)
+{
+    PROF_ZONE("gen_caves");
+    BitGrid rock, next, open;
+    rock.resize(floor.size, floor.size, true);
+    int kept = 0;
+    // every try's steps show up as cave_step zones, a step's throughput is size * size over its zone
+    for (int tries = 0; tries < CAVE_TRIES; ++tries) {
+        cave_seed(rock, CAVE_FILL, rng);
+        for (int step = 0; step < CAVE_STEPS; ++step) {
+            cave_step(rock, next);
+            std::swap(rock, next);
+        }
+        kept = cave_keep_largest(rock, open);
+        if ((long long)kept * 4 >= (long long)floor.size * floor.size)
+            break;
+    }
+    // somewhere to stand even if every seed came out solid, two tiles side by
+    // side so both stairs fit when they land in the same block
+    if (kept < 2) {
+        open.resize(floor.size, floor.size, false);
+        open.set(floor.size / 2, floor.size / 2, true);
+        open.set(floor.size / 2, floor.size / 2 + 1, true);
+        kept = 2;
+    }
+    for (int i = 0; i < floor.size; ++i) {
+        const uint64_t *row = open.row(i);
+        for (int w = 0; w < open.words; ++w) {
+            for (uint64_t word = row[w]; word; word &= word - 1)
+                floor.set_tile(i, w * 64 + __builtin_ctzll(word), FLOOR);
+        }
+    }
+
+    // each block stands in for a room, so spawning and exploring work as on room floors
+    for (int gi = 0; gi < floor.graph_size; ++gi) {
+        for (int gj = 0; gj < floor.graph_size; ++gj) {
+            Room& room = floor.room(gi, gj);
+            room.is_connected = true;
+            room.map_i = floor.block_lo(gi);
+            room.map_j = floor.block_lo(gj);
+            room.map_h = floor.block_hi(gi) - room.map_i + 1;
+            room.map_w = floor.block_hi(gj) - room.map_j + 1;
+            room.center_i = room.map_i + room.map_h / 2;
+            room.center_j = room.map_j + room.map_w / 2;
+        }
+    }
+
+    // start and stairs in the blocks of two random open tiles, different ones when the cave allows
+    int i, j;
+    cave_tile(open, rng.range(0, kept), &i, &j);
+    floor.Start_i = floor.block_of(i);
+    floor.Start_j = floor.block_of(j);
+    for (int tries = 0; tries < CAVE_TRIES; ++tries) {
+        cave_tile(open, rng.range(0, kept), &i, &j);
+        floor.End_i = floor.block_of(i);
+        floor.End_j = floor.block_of(j);
+        if (!coords_equal(floor.Start_i, floor.Start_j, floor.End_i, floor.End_j))
+            break;
+    }
+}
+
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+namespace Modules {
+
+/******************************************************************************
+ * Cave Generation
+ *
+ * http://www.roguebasin.com/index.php/Cellular_Automata_Method_for_Generating_Random_Cave-Like_Levels
+ *
+ * Rock is seeded at random over a bitboard and smoothed by the 4-5 rule: a
+ * tile is rock next step when 5 or more of the 9 tiles around and including
+ * it are rock. Every step works on whole words, counting the 9 tiles of 64
+ * neighborhoods at once in bit-sliced adders, then only the largest cave is
+ * kept so every open tile can be walked to.
+ */
+
+struct BitGrid;
+struct Floor;
+struct Rng;
+
+void cave_seed(BitGrid& rock, int fill, Rng& rng); // rock on about fill sixteenths of the tiles, border always rock
+void cave_step(const BitGrid& rock, BitGrid& out); // one automaton step, out the same size as rock
+int cave_keep_largest(const BitGrid& rock, BitGrid& open); // open tiles of the largest cave, returns its size
+void gen_caves(Floor& floor, Rng& rng); // generate the map and rooms of floor as caves
+
+}
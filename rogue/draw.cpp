@@ -1,4 +1,9 @@
+#include <algorithm>
+#include <cstdio>
+#include <vector>
+
 #include "../../pse.hpp"
+#include "../prof/zones.hpp"
 
 #include "draw.hpp"
 #include "gen.hpp"
@@ -21,13 +26,13 @@ void load_sprites()
 void draw_graph()
 {
     // draw rooms and doors
-    for (int i = 0; i < GRAPH_SIZE; ++i) {
-        for (int j = 0; j < GRAPH_SIZE; ++j) {
+    for (int i = 0; i < FLR.graph_size; ++i) {
+        for (int j = 0; j < FLR.graph_size; ++j) {
             draw_graph_room(i, j);
         }
     }
-    for (int i = 0; i < GRAPH_SIZE; ++i) {
-        for (int j = 0; j < GRAPH_SIZE; ++j) {
+    for (int i = 0; i < FLR.graph_size; ++i) {
+        for (int j = 0; j < FLR.graph_size; ++j) {
             draw_graph_doors(i, j);
         }
     }
@@ -40,7 +45,7 @@ void draw_graph_room(int i, int j)
         c = pse::Sky;
     else if (i == FLR.End_i && j == FLR.End_j)
         c = pse::Orange;
-    else if (FLR.Graph[i][j].index == 0)
+    else if (FLR.room(i, j).index == 0)
         c = pse::Red;
     else
         c = pse::Blue;
@@ -54,10 +59,10 @@ void draw_graph_room(int i, int j)
 
 void draw_graph_doors(int i, int j)
 {
-    for (int k = 0; k < FLR.Graph[i][j].index; ++k) {
+    for (int k = 0; k < FLR.room(i, j).index; ++k) {
         int x = j * TILE_SCALING;
         int y = i * TILE_SCALING;
-        switch (FLR.Graph[i][j].neighbors[k]) {
+        switch (FLR.room(i, j).neighbors[k]) {
         case UP:
             PSE_Context->draw_rect_fill(pse::Purple, SDL_Rect{
                 x + TILE_SCALING / 2 - TILE_WIDTH / 2,
@@ -89,73 +94,244 @@ void draw_graph_doors(int i, int j)
     }
 }
 
-void draw_map()
+void camera_update()
 {
-    for (int i = 0; i < MAP_SIZE; ++i) {
-        for (int j = 0; j < MAP_SIZE; ++j) {
-            SDL_Color c;
-            SDL_Rect tile = SDL_Rect{ j * TILE_WIDTH, i * TILE_WIDTH, TILE_WIDTH, TILE_WIDTH };
-            switch (FLR.Map[i][j]) {
-                case WALL:
-                    PSE_Context->draw_image(SpriteWallId, tile);
-                    break;
-                case FLOOR:
-                    if (Player.graph_x == map_to_graph_index(j) && Player.graph_y == map_to_graph_index(i))
-                        PSE_Context->draw_image(SpriteFloorLightId, tile);
-                    else if (FLR.Graph[map_to_graph_index(i)][map_to_graph_index(j)].is_explored)
-                        PSE_Context->draw_image(SpriteFloorDarkId, tile);
-                    else
-                        PSE_Context->draw_image(SpriteWallId, tile);
-                    break;
-                case EMPTY:
-                    PSE_Context->draw_rect_fill(pse::Black, tile);
-                    break;
-                default:
-                    PSE_Context->draw_rect_fill(pse::Magenta, tile);
-            }
+    // as many tiles as fit the window, centered on the player and kept inside the map
+    ViewRows = std::min(FLR.size, PSE_Context->screen_height / TILE_WIDTH + 1);
+    ViewCols = std::min(FLR.size, PSE_Context->screen_width / TILE_WIDTH + 1);
+    ViewTop = std::max(0, std::min(Player.map_y - ViewRows / 2, FLR.size - ViewRows));
+    ViewLeft = std::max(0, std::min(Player.map_x - ViewCols / 2, FLR.size - ViewCols));
+}
+
+/**
+ * Map layer
+ */
+
+// one chunk of the map drawn into a texture, only its dirty tiles are drawn again
+struct LayerChunk {
+    int chunk = -1; // index in the Map's chunks, -1 while unused
+    SDL_Texture *texture = nullptr;
+    int dirty_lo_i = 0, dirty_lo_j = 0; // chunk local tiles still to draw, inclusive
+    int dirty_hi_i = CHUNK_MASK, dirty_hi_j = CHUNK_MASK;
+    uint64_t used = 0; // frame it was last copied to the screen
+};
+
+// about MAP_LAYER_CHUNKS of them, a scan is fine
+static std::vector<LayerChunk> LayerChunks;
+static uint64_t LayerFrame = 0;
+static int LitRoom = -1; // the room drawn lit, the player's when it was drawn
+static bool LayerFailed = false; // no render targets, tiles are drawn one by one
+
+static void draw_tile(int i, int j, SDL_Rect rect)
+{
+    switch (FLR.tile(i, j)) {
+        case WALL:
+            PSE_Context->draw_image(SpriteWallId, rect);
+            break;
+        case FLOOR: {
+            int gi = FLR.block_of(i);
+            int gj = FLR.block_of(j);
+            if (Player.graph_y == gi && Player.graph_x == gj)
+                PSE_Context->draw_image(SpriteFloorLightId, rect);
+            else if (FLR.room(gi, gj).is_explored)
+                PSE_Context->draw_image(SpriteFloorDarkId, rect);
+            else
+                PSE_Context->draw_image(SpriteWallId, rect);
+            break;
         }
+        case EMPTY:
+            PSE_Context->draw_rect_fill(pse::Black, rect);
+            break;
+        default:
+            PSE_Context->draw_rect_fill(pse::Magenta, rect);
     }
 }
 
-void draw_entities()
+void map_layer_invalidate()
+{
+    for (LayerChunk& layer : LayerChunks)
+        layer.chunk = -1;
+    LitRoom = -1;
+}
+
+void map_layer_invalidate_room(int gi, int gj)
+{
+    for (LayerChunk& layer : LayerChunks) {
+        if (layer.chunk < 0)
+            continue;
+        int top = layer.chunk / FLR.Map.chunks_w << CHUNK_BITS;
+        int left = layer.chunk % FLR.Map.chunks_w << CHUNK_BITS;
+        // the block's tiles in the chunk, chunk local
+        int lo_i = std::max(FLR.block_lo(gi), top) - top;
+        int hi_i = std::min(FLR.block_hi(gi), top + CHUNK_MASK) - top;
+        int lo_j = std::max(FLR.block_lo(gj), left) - left;
+        int hi_j = std::min(FLR.block_hi(gj), left + CHUNK_MASK) - left;
+        if (lo_i > hi_i || lo_j > hi_j)
+            continue;
+        if (layer.dirty_lo_i > layer.dirty_hi_i) {
+            layer.dirty_lo_i = lo_i;
+            layer.dirty_lo_j = lo_j;
+            layer.dirty_hi_i = hi_i;
+            layer.dirty_hi_j = hi_j;
+        }
+        else {
+            layer.dirty_lo_i = std::min(layer.dirty_lo_i, lo_i);
+            layer.dirty_lo_j = std::min(layer.dirty_lo_j, lo_j);
+            layer.dirty_hi_i = std::max(layer.dirty_hi_i, hi_i);
+            layer.dirty_hi_j = std::max(layer.dirty_hi_j, hi_j);
+        }
+    }
+}
+
+// texture of a map chunk with every tile up to date, nullptr without render targets
+static SDL_Texture *layer_chunk(int ci, int cj)
 {
-    // traverse backwards, make first inserted displayed on top
-    for (int i = 0; i < EntityIndex; ++i) {
-        if (!Entities[i]) {
-            #ifdef DEBUG
-                printf("Invalid entity: %d\n", i);
-            #endif
+    int chunk = ci * FLR.Map.chunks_w + cj;
+    LayerChunk *layer = nullptr;
+    for (LayerChunk& cached : LayerChunks) {
+        if (cached.chunk == chunk) {
+            layer = &cached;
             break;
         }
-        
-        SDL_Rect rect{ Entities[i]->map_x * TILE_WIDTH, Entities[i]->map_y * TILE_WIDTH, TILE_WIDTH, TILE_WIDTH };
-        SDL_Color c;
+    }
 
-        switch (Entities[i]->id) {
-            case ID_PLAYER:
-                PSE_Context->draw_image(SpritePlayerId, rect);
+    if (!layer) {
+        // a texture left unused, a new one while there are few, else the least recently drawn chunk's
+        for (LayerChunk& cached : LayerChunks) {
+            if (cached.chunk < 0) {
+                layer = &cached;
                 break;
+            }
+        }
+        if (!layer && (int)LayerChunks.size() >= MAP_LAYER_CHUNKS) {
+            auto oldest = std::min_element(LayerChunks.begin(), LayerChunks.end(),
+                [](const LayerChunk& a, const LayerChunk& b) { return a.used < b.used; });
+            // never a chunk already on screen this frame
+            if (oldest->used != LayerFrame)
+                layer = &*oldest;
+        }
+        if (!layer) {
+            SDL_Texture *texture = SDL_CreateTexture(PSE_Context->renderer, SDL_PIXELFORMAT_RGBA8888,
+                SDL_TEXTUREACCESS_TARGET, CHUNK_SIZE * TILE_WIDTH, CHUNK_SIZE * TILE_WIDTH);
+            if (!texture) {
+                fprintf(stderr, "Error: Could not create map layer texture: %s\n", SDL_GetError());
+                LayerFailed = true;
+                return nullptr;
+            }
+            LayerChunks.push_back(LayerChunk{});
+            LayerChunks.back().texture = texture;
+            layer = &LayerChunks.back();
+        }
+        layer->chunk = chunk;
+        layer->dirty_lo_i = 0;
+        layer->dirty_lo_j = 0;
+        layer->dirty_hi_i = CHUNK_MASK;
+        layer->dirty_hi_j = CHUNK_MASK;
+    }
+    layer->used = LayerFrame;
+
+    if (layer->dirty_lo_i <= layer->dirty_hi_i) {
+        PROF_ZONE("map_layer_draw");
+        int top = ci << CHUNK_BITS;
+        int left = cj << CHUNK_BITS;
+        SDL_Texture *screen = SDL_GetRenderTarget(PSE_Context->renderer);
+        SDL_SetRenderTarget(PSE_Context->renderer, layer->texture);
+        for (int i = layer->dirty_lo_i; i <= layer->dirty_hi_i && top + i < FLR.size; ++i) {
+            for (int j = layer->dirty_lo_j; j <= layer->dirty_hi_j && left + j < FLR.size; ++j)
+                draw_tile(top + i, left + j, SDL_Rect{ j * TILE_WIDTH, i * TILE_WIDTH, TILE_WIDTH, TILE_WIDTH });
+        }
+        SDL_SetRenderTarget(PSE_Context->renderer, screen);
+        layer->dirty_lo_i = CHUNK_SIZE;
+        layer->dirty_hi_i = -1;
+    }
+    return layer->texture;
+}
+
+void draw_map()
+{
+    PROF_ZONE("draw_map");
+    camera_update();
+    LayerFrame++;
+    // the light follows the player from room to room
+    int lit = Player.graph_y * FLR.graph_size + Player.graph_x;
+    if (lit != LitRoom) {
+        if (LitRoom >= 0)
+            map_layer_invalidate_room(LitRoom / FLR.graph_size, LitRoom % FLR.graph_size);
+        map_layer_invalidate_room(Player.graph_y, Player.graph_x);
+        LitRoom = lit;
+    }
+
+    // one copy for the part of each chunk on screen
+    int bottom = ViewTop + ViewRows - 1;
+    int right = ViewLeft + ViewCols - 1;
+    for (int ci = ViewTop >> CHUNK_BITS; ci <= bottom >> CHUNK_BITS; ++ci) {
+        for (int cj = ViewLeft >> CHUNK_BITS; cj <= right >> CHUNK_BITS; ++cj) {
+            int top = ci << CHUNK_BITS;
+            int left = cj << CHUNK_BITS;
+            int lo_i = std::max(ViewTop, top);
+            int hi_i = std::min(bottom, top + CHUNK_MASK);
+            int lo_j = std::max(ViewLeft, left);
+            int hi_j = std::min(right, left + CHUNK_MASK);
+
+            SDL_Texture *texture = LayerFailed ? nullptr : layer_chunk(ci, cj);
+            if (!texture) {
+                for (int i = lo_i; i <= hi_i; ++i) {
+                    for (int j = lo_j; j <= hi_j; ++j)
+                        draw_tile(i, j, SDL_Rect{ (j - ViewLeft) * TILE_WIDTH, (i - ViewTop) * TILE_WIDTH, TILE_WIDTH, TILE_WIDTH });
+                }
+                continue;
+            }
+            SDL_Rect src{ (lo_j - left) * TILE_WIDTH, (lo_i - top) * TILE_WIDTH,
+                (hi_j - lo_j + 1) * TILE_WIDTH, (hi_i - lo_i + 1) * TILE_WIDTH };
+            SDL_Rect dst{ (lo_j - ViewLeft) * TILE_WIDTH, (lo_i - ViewTop) * TILE_WIDTH, src.w, src.h };
+            SDL_RenderCopy(PSE_Context->renderer, texture, &src, &dst);
+        }
+    }
+}
+
+// sprite on a map tile, if the camera sees it
+static void draw_tile_image(int sprite, int map_i, int map_j)
+{
+    int view_i = map_i - ViewTop;
+    int view_j = map_j - ViewLeft;
+    if (view_i < 0 || view_i >= ViewRows || view_j < 0 || view_j >= ViewCols)
+        return;
+    PSE_Context->draw_image(sprite, SDL_Rect{ view_j * TILE_WIDTH, view_i * TILE_WIDTH, TILE_WIDTH, TILE_WIDTH });
+}
+
+void draw_entities()
+{
+    PROF_ZONE("draw_entities");
+    const Entity& down = FLR.StairDown;
+    const Entity& up = FLR.StairUp;
+    draw_tile_image(FLR.room(down.graph_y, down.graph_x).is_explored ? SpriteStairDownId : SpriteWallId, down.map_y, down.map_x);
+    draw_tile_image(SpriteStairUpId, up.map_y, up.map_x);
+    draw_tile_image(SpritePlayerId, Player.map_y, Player.map_x);
+
+    // pooled entities, one pass over the positions culls what the camera doesn't see
+    const EntityPool& pool = FLR.Entities;
+    int bottom = ViewTop + ViewRows;
+    int right = ViewLeft + ViewCols;
+    for (int k = 0; k < pool.size(); ++k) {
+        int i = pool.map_y[k];
+        int j = pool.map_x[k];
+        if (i < ViewTop || i >= bottom || j < ViewLeft || j >= right)
+            continue;
+        SDL_Rect rect{ (j - ViewLeft) * TILE_WIDTH, (i - ViewTop) * TILE_WIDTH, TILE_WIDTH, TILE_WIDTH };
+
+        switch (pool.id[k]) {
             case ID_ENEMY:
-                if (!FLR.Graph[Entities[i]->graph_y][Entities[i]->graph_x].is_explored)
+                if (!FLR.room(pool.graph_y[k], pool.graph_x[k]).is_explored)
                     PSE_Context->draw_image(SpriteWallId, rect);
-                else if (coords_equal(Player.graph_x, Player.graph_y, Entities[i]->graph_x, Entities[i]->graph_y))
+                else if (coords_equal(Player.graph_x, Player.graph_y, pool.graph_x[k], pool.graph_y[k]))
                     PSE_Context->draw_image(SpriteEnemyId, rect);
                 else
                     PSE_Context->draw_image(SpriteFloorDarkId, rect);
                 break;
-            case ID_STAIR_DOWN:
-                if (FLR.Graph[FLR.StairDown.graph_y][FLR.StairDown.graph_x].is_explored)
-                    PSE_Context->draw_image(SpriteStairDownId, rect);
-                else
-                    PSE_Context->draw_image(SpriteWallId, rect);
-                break;
-            case ID_STAIR_UP:
-                PSE_Context->draw_image(SpriteStairUpId, rect);
-                break;
             default:
                 PSE_Context->draw_rect_fill(pse::Magenta, rect);
         }
     }
 }
 
-}
\ No newline at end of file
+}
@@ -6,7 +6,14 @@ void load_sprites();
 void draw_graph();
 void draw_graph_room(int i, int j);
 void draw_graph_doors(int i, int j);
+void camera_update(); // the window onto the map, follows the player
+
+// tiles are drawn once into a texture per map chunk, each frame only copies
+// the chunks on screen. A room's tiles are drawn again when it's explored or
+// the player walks in or out of it, every chunk when the floor changes
 void draw_map();
+void map_layer_invalidate(); // a different or regenerated floor
+void map_layer_invalidate_room(int gi, int gj); // the room looks different, is_explored flipped
 void draw_entities();
 
 }
\ No newline at end of file
@@ -0,0 +1,116 @@
+#include <algorithm>
+#include <cstdio>
+#include <vector>
+
+#include "../../pse.hpp"
+#include "draw.hpp"
+#include "dungeon.hpp"
+#include "entity.hpp"
+#include "gen.hpp"
+#include "globals.hpp"
+#include "save.hpp"
+#include "types.hpp"
+
+namespace Modules {
+
+struct Resident {
+    int level;
+    std::unique_ptr<Floor> floor;
+};
+
+// most recently used first, a handful of floors so a scan is fine
+static std::vector<Resident> Residents;
+
+static void touch(size_t k)
+{
+    std::rotate(Residents.begin(), Residents.begin() + k, Residents.begin() + k + 1);
+}
+
+// save and drop the least recently used floors past FloorsResident, never the current one
+static void evict()
+{
+    for (size_t k = Residents.size(); k-- > 0 && Residents.size() > (size_t)FloorsResident;) {
+        if (Residents[k].floor.get() == CurrentFloor)
+            continue;
+        floor_save(*Residents[k].floor, Residents[k].level);
+        Residents.erase(Residents.begin() + k);
+    }
+}
+
+void dungeon_insert(int level, std::unique_ptr<Floor> floor)
+{
+    for (size_t k = 0; k < Residents.size(); ++k) {
+        if (Residents[k].level == level) {
+            Residents[k].floor = std::move(floor);
+            touch(k);
+            return;
+        }
+    }
+    Residents.insert(Residents.begin(), Resident{ level, std::move(floor) });
+    evict();
+}
+
+Floor& dungeon_floor(int level)
+{
+    for (size_t k = 0; k < Residents.size(); ++k) {
+        if (Residents[k].level == level) {
+            touch(k);
+            return *Residents[0].floor;
+        }
+    }
+    std::unique_ptr<Floor> floor(new Floor{});
+    if (!floor_load(*floor, level))
+        gen_floor(*floor, FloorSize, FloorGenerator, floor_seed(level));
+    Floor& resident = *floor;
+    dungeon_insert(level, std::move(floor));
+    return resident;
+}
+
+bool dungeon_has(int level)
+{
+    for (const Resident& resident : Residents) {
+        if (resident.level == level)
+            return true;
+    }
+    return floor_saved(level);
+}
+
+void dungeon_save()
+{
+    for (const Resident& resident : Residents)
+        floor_save(*resident.floor, resident.level);
+    dungeon_save_state();
+}
+
+void dungeon_start()
+{
+    FloorLevel = 0;
+    LastStairDirection = UP;
+    CurrentFloor = &dungeon_floor(FloorLevel);
+    floor_enter();
+}
+
+bool dungeon_resume()
+{
+    int player_i, player_j;
+    if (!dungeon_load_state(&player_i, &player_j))
+        return false;
+    CurrentFloor = &dungeon_floor(FloorLevel);
+    floor_enter();
+
+    // back where the player stood, if that's still somewhere to stand
+    if (FLR.Map.contains(player_i, player_j) && FLR.walkable(player_i, player_j)) {
+        vacate(FLR, Player.map_y, Player.map_x);
+        occupy(FLR, player_i, player_j);
+        Player.map_y = player_i;
+        Player.map_x = player_j;
+        Player.graph_y = map_to_graph_index(player_i);
+        Player.graph_x = map_to_graph_index(player_j);
+        FLR.room(Player.graph_y, Player.graph_x).is_explored = true;
+        map_layer_invalidate_room(Player.graph_y, Player.graph_x);
+    }
+    printf("Resumed floor %d of dungeon %016llx\n", FloorLevel, (unsigned long long)DungeonSeed);
+    return true;
+}
+
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <memory>
+
+namespace Modules {
+
+/******************************************************************************
+ * Dungeon
+ *
+ * Only the FloorsResident most recently used floors stay in memory, older
+ * ones are saved to SaveDir and dropped. A floor that isn't resident is
+ * loaded back from its file, or generated from its seed if it has none, so
+ * the dungeon has no bottom and memory stays bounded.
+ */
+
+struct Floor;
+
+Floor& dungeon_floor(int level); // resident floor of level, loaded or generated if it isn't
+void dungeon_insert(int level, std::unique_ptr<Floor> floor); // a floor generated elsewhere becomes resident
+bool dungeon_has(int level); // resident or saved, nothing to generate
+void dungeon_save(); // every resident floor and the dungeon state, at exit
+void dungeon_start(); // enter level 0 of the dungeon of DungeonSeed
+bool dungeon_resume(); // enter the saved dungeon where it was left, false if there's none
+
+}
@@ -1,65 +1,106 @@
 #include <algorithm>
 
+#include "../prof/counters.hpp"
+#include "../prof/zones.hpp"
+#include "draw.hpp"
 #include "entity.hpp"
 #include "gen.hpp"
 #include "globals.hpp"
+#include "path.hpp"
 #include "types.hpp"
 
 namespace Modules {
 
-void entity_insert(Entity *e)
+/**
+ * Occupancy
+ */
+
+// list or unlist a tile whose occupancy changed, once its room has a list
+static void free_tile_update(Floor& floor, int i, int j)
 {
-    if (EntityIndex + 1 < ENTITY_MAX) {
-        Entities[EntityIndex++] = e;
+    Room& room = floor.room(floor.block_of(i), floor.block_of(j));
+    if (!room.free_listed)
+        return;
+    int slot = floor.FreeSlot.get(i, j);
+    bool free = floor.walkable(i, j) && floor.Occupancy.get(i, j) == 0;
+    if (free && slot < 0) {
+        floor.FreeSlot.set(i, j, (int)room.free_tiles.size());
+        room.free_tiles.push_back(i * floor.size + j);
+    }
+    else if (!free && slot >= 0) {
+        // the last tile fills the hole
+        int last = room.free_tiles.back();
+        room.free_tiles[slot] = last;
+        floor.FreeSlot.set(last / floor.size, last % floor.size, slot);
+        room.free_tiles.pop_back();
+        floor.FreeSlot.set(i, j, -1);
     }
 }
 
-void rand_room_tile(int gi, int gj, int *i, int *j)
+static void free_tiles_build(Floor& floor, int gi, int gj)
 {
-    if (FLR.Graph[gi][gj].is_gone)
-        FLR.Graph[gi][gj].rand_corridor(i, j);
-    else
-        FLR.Graph[gi][gj].rand_tile(i, j);
+    Room& room = floor.room(gi, gj);
+    room.free_tiles.clear();
+    room.free_tiles.reserve(room.open_tiles);
+    for (int i = floor.block_lo(gi); i <= floor.block_hi(gi); ++i) {
+        for (int j = floor.block_lo(gj); j <= floor.block_hi(gj); ++j) {
+            if (floor.walkable(i, j) && floor.Occupancy.get(i, j) == 0) {
+                floor.FreeSlot.set(i, j, (int)room.free_tiles.size());
+                room.free_tiles.push_back(i * floor.size + j);
+            }
+        }
+    }
+    room.free_listed = true;
 }
 
-void rand_room_tile_no_overlap(int gi, int gj, int *i, int *j)
+void occupy(Floor& floor, int i, int j)
 {
-    do {
-        rand_room_tile(gi, gj, i, j);
-    } while (!empty_coords(*i, *j));
+    uint8_t& count = floor.Occupancy.at(i, j);
+    if (count == UINT8_MAX) {
+        fprintf(stderr, "Error: Too many entities on tile (%d, %d)\n", i, j);
+        exit(-1);
+    }
+    if (count++ == 0)
+        free_tile_update(floor, i, j);
 }
 
-bool empty_coords(int i, int j)
+void vacate(Floor& floor, int i, int j)
 {
-    for (int k = 0; k < ENTITY_MAX; ++k) {
-        if (!Entities[k])
-            continue;
-        if (Entities[k]->map_y == i && Entities[k]->map_x == j)
-            return false;
+    if (floor.Occupancy.get(i, j) == 0) {
+        fprintf(stderr, "Error: Nothing to vacate on tile (%d, %d)\n", i, j);
+        exit(-1);
     }
+    if (--floor.Occupancy.at(i, j) == 0)
+        free_tile_update(floor, i, j);
+}
+
+bool rand_room_free_tile(Floor& floor, Rng& rng, int gi, int gj, int *i, int *j)
+{
+    Room& room = floor.room(gi, gj);
+    if (!room.free_listed)
+        free_tiles_build(floor, gi, gj);
+    if (room.free_tiles.empty())
+        return false;
+    int tile = room.free_tiles[rng.range(0, (int)room.free_tiles.size())];
+    *i = tile / floor.size;
+    *j = tile % floor.size;
     return true;
 }
 
-void spawn_entities()
+bool empty_coords(int i, int j)
 {
-    // stop looking at each entity
-    for (int i = 0; i < ENTITY_MAX; ++i) {
-        if (!Entities[i])
-            continue;
-        
-        if (Entities[i]->is_enemy) {
-            delete Entities[i];
-        }
+    return floor_coords_empty(FLR, i, j);
+}
 
-        Entities[i] = nullptr;
-    }
-    // reset
-    EntityIndex = 0;
+bool floor_coords_empty(const Floor& floor, int i, int j)
+{
+    return floor.Occupancy.get(i, j) == 0;
+}
 
-    // "permanent" entities
-    spawn_stairs();
+void spawn_entities()
+{
+    // enemies stay with their floor, only the player comes along
     spawn_player();
-    spawn_enemies();
 }
 
 void spawn_player()
@@ -82,142 +123,285 @@ void spawn_player()
         exit(-1);
     }
     Player.id = ID_PLAYER;
-    FLR.Graph[Player.graph_y][Player.graph_x].is_explored = true;
+    FLR.room(Player.graph_y, Player.graph_x).is_explored = true;
+    occupy(FLR, Player.map_y, Player.map_x);
+}
 
-    entity_insert(&Player);
+static void spawn_stair(Floor& floor, Rng& rng, Entity& stair, int gi, int gj, int id)
+{
+    stair = Entity{};
+    if (!rand_room_free_tile(floor, rng, gi, gj, &stair.map_y, &stair.map_x)) {
+        fprintf(stderr, "Error: Room (%d, %d) has no free tiles\n", gi, gj);
+        exit(-1);
+    }
+    stair.graph_y = gi;
+    stair.graph_x = gj;
+    stair.id = id;
+    occupy(floor, stair.map_y, stair.map_x);
 }
 
-void spawn_stairs()
+void spawn_stairs(Floor& floor, Rng& rng)
 {
-    if (!FLR.visited) {
-        rand_room_tile_no_overlap(FLR.End_i, FLR.End_j, &FLR.StairDown.map_y, &FLR.StairDown.map_x);
-        rand_room_tile_no_overlap(FLR.Start_i, FLR.Start_j, &FLR.StairUp.map_y, &FLR.StairUp.map_x);
+    spawn_stair(floor, rng, floor.StairDown, floor.End_i, floor.End_j, ID_STAIR_DOWN);
+    spawn_stair(floor, rng, floor.StairUp, floor.Start_i, floor.Start_j, ID_STAIR_UP);
+}
 
-        FLR.StairDown.graph_x = FLR.End_j;
-        FLR.StairDown.graph_y = FLR.End_i;
-        FLR.StairDown.id = ID_STAIR_DOWN;
+void spawn_enemies(Floor& floor, Rng& rng)
+{
+    int count = EnemyCount > 0 ? EnemyCount : rng.range(ENEMY_MIN, ENEMY_MAX);
+    floor.Entities.clear();
+    floor.Entities.reserve(count);
+
+    // rooms with somewhere to stand, dropped once they fill up so a full floor ends the spawning
+    std::vector<int> rooms;
+    for (int k = 0; k < (int)floor.Graph.size(); ++k) {
+        if (floor.Graph[k].open_tiles > 0)
+            rooms.push_back(k);
+    }
+    while (floor.Entities.size() < count && !rooms.empty()) {
+        int k = rng.range(0, (int)rooms.size());
+        int gi = rooms[k] / floor.graph_size;
+        int gj = rooms[k] % floor.graph_size;
+        int i, j;
+        if (!rand_room_free_tile(floor, rng, gi, gj, &i, &j)) {
+            rooms[k] = rooms.back();
+            rooms.pop_back();
+            continue;
+        }
+        occupy(floor, i, j);
+        floor.Entities.spawn(ID_ENEMY, i, j, gi, gj);
+    }
+}
 
-        FLR.StairUp.graph_x = FLR.Start_j;
-        FLR.StairUp.graph_y = FLR.Start_i;
-        FLR.StairUp.id = ID_STAIR_UP;
+// neighbor offsets, in the order of Direction
+static const int NeighborI[NEIGHBORS_MAX] = { -1, 0, 1, 0 };
+static const int NeighborJ[NEIGHBORS_MAX] = { 0, 1, 0, -1 };
 
-        FLR.visited = true;
-    }
+static Node& node_at(int index)
+{
+    return Nodes.at(index / FLR.size, index % FLR.size);
+}
 
-    entity_insert(&FLR.StairDown);
-    entity_insert(&FLR.StairUp);
+// lowest global goal first, ties to the node further along which tends to be closer to the end
+static bool node_before(const OpenNode& a, const OpenNode& b)
+{
+    if (a.node->global_goal != b.node->global_goal)
+        return a.node->global_goal < b.node->global_goal;
+    return a.node->local_goal > b.node->local_goal;
 }
 
-void spawn_enemies()
+static void heap_place(int pos, const OpenNode& open)
 {
-    for (int i = 0; i < rand_range(ENEMY_MIN, ENEMY_MAX); ++i) {
-        Entity *enemy = new Entity{};
+    OpenNodes[pos] = open;
+    open.node->heap_index = pos;
+}
 
-        enemy->is_enemy = true;
-        enemy->id = ID_ENEMY;
-        // pick random room
-        enemy->graph_x = rand_range(0, GRAPH_SIZE);
-        enemy->graph_y = rand_range(0, GRAPH_SIZE);
-        rand_room_tile_no_overlap(enemy->graph_y, enemy->graph_x, &enemy->map_y, &enemy->map_x);
+static void heap_up(int pos)
+{
+    OpenNode open = OpenNodes[pos];
+    while (pos > 0) {
+        int parent = (pos - 1) / 2;
+        if (!node_before(open, OpenNodes[parent]))
+            break;
+        heap_place(pos, OpenNodes[parent]);
+        pos = parent;
+    }
+    heap_place(pos, open);
+}
+
+static void heap_down(int pos)
+{
+    int size = (int)OpenNodes.size();
+    OpenNode open = OpenNodes[pos];
+    for (;;) {
+        int child = pos * 2 + 1;
+        if (child >= size)
+            break;
+        if (child + 1 < size && node_before(OpenNodes[child + 1], OpenNodes[child]))
+            child += 1;
+        if (!node_before(OpenNodes[child], open))
+            break;
+        heap_place(pos, OpenNodes[child]);
+        pos = child;
+    }
+    heap_place(pos, open);
+}
 
-        entity_insert(enemy);
+static OpenNode heap_pop()
+{
+    OpenNode top = OpenNodes[0];
+    OpenNode last = OpenNodes.back();
+    OpenNodes.pop_back();
+    if (!OpenNodes.empty()) {
+        heap_place(0, last);
+        heap_down(0);
     }
+    top.node->heap_index = NODE_CLOSED;
+    return top;
 }
 
 void astar_init()
 {
-    for (int i = 0; i < MAP_SIZE; ++i) {
-        for (int j = 0; j < MAP_SIZE; ++j) {
-            if (i > 0)
-                Nodes[i][j].neighbors.push_back(&Nodes[i - 1][j]);
-            if (i < MAP_SIZE - 1)
-                Nodes[i][j].neighbors.push_back(&Nodes[i + 1][j]);
-            if (j > 0)
-                Nodes[i][j].neighbors.push_back(&Nodes[i][j - 1]);
-            if (j < MAP_SIZE - 1)
-                Nodes[i][j].neighbors.push_back(&Nodes[i][j + 1]);
-        }
-    }
-    UntestedNodes.resize((size_t)((float)MAP_SIZE * logf(MAP_SIZE)));
+    OpenNodes.reserve(MAP_SIZE * MAP_SIZE);
+    FlowQueue.reserve(MAP_SIZE * MAP_SIZE);
+    flow_invalidate();
 }
 
 void astar_reset()
 {
-    for (int i = 0; i < MAP_SIZE; ++i) {
-        for (int j = 0; j < MAP_SIZE; ++j) {
-            Nodes[i][j].x = j;
-            Nodes[i][j].y = i;
-            if (FLR.Map[i][j] == WALL)
-                Nodes[i][j].obstacle = true;
-            else
-                Nodes[i][j].obstacle = false;
-            Nodes[i][j].parent = nullptr;
-            Nodes[i][j].visited = false;
-            Nodes[i][j].global_goal = INFINITY;
-            Nodes[i][j].local_goal = INFINITY;
-        }
+    // nodes from older searches are stale by their generation, nothing to clear
+    if (Nodes.width != FLR.size)
+        Nodes.resize(FLR.size, FLR.size, Node{});
+    if (++SearchGeneration == 0) {
+        Nodes.clear();
+        SearchGeneration = 1;
     }
+    OpenNodes.clear();
+}
+
+bool astar_solve(int start_i, int start_j, int end_i, int end_j)
+{
+    return astar_solve_in(start_i, start_j, end_i, end_j, 0, 0, FLR.size - 1, FLR.size - 1);
 }
 
-void astar_solve(int start_i, int start_j, int end_i, int end_j)
+bool astar_solve_in(int start_i, int start_j, int end_i, int end_j, int lo_i, int lo_j, int hi_i, int hi_j)
 {
+    PROF_COUNTERS("rogue astar_solve");
+    PROF_ZONE("astar_solve");
     astar_reset();
 
     // start conditions
-    Node *start = &Nodes[start_i][start_j];
-    Node *end = &Nodes[end_i][end_j];
-
-    Node *current = start;
-    current->local_goal = 0.0f;
-    current->global_goal = Node::dist(start, end);
-    UntestedNodes.clear();
-    UntestedNodes.push_back(start);
-
-    while (!UntestedNodes.empty()) {
-        // sort by global goal
-        std::sort(std::begin(UntestedNodes), std::end(UntestedNodes), Node::cmp);
-
-        // ignore nodes already visited
-        while (!UntestedNodes.empty() && UntestedNodes.front()->visited)
-            UntestedNodes.pop_front();
-        
-        // popped last node
-        if (UntestedNodes.empty())
-            break;
-
-        current = UntestedNodes.front();
-        current->visited = true;
-
-        // check neighbors
-        for (auto neighbor: current->neighbors) {
-            // record the neighbor if it wasn't visited yet
-            if (!neighbor->visited && !neighbor->obstacle)
-                UntestedNodes.push_back(neighbor);
-
-            // find local goals
-            float possible_goal = current->local_goal + Node::dist(current, neighbor);
-            if (possible_goal < neighbor->local_goal) {
-                neighbor->parent = current;
-                neighbor->local_goal = possible_goal;
-                neighbor->global_goal = neighbor->local_goal + Node::dist(neighbor, end);
+    int size = FLR.size;
+    int start = start_i * size + start_j;
+    int end = end_i * size + end_j;
+    Node& first = node_at(start);
+    first.generation = SearchGeneration;
+    first.local_goal = 0;
+    first.global_goal = Node::dist(start_i, start_j, end_i, end_j);
+    first.parent = -1;
+    first.heap_index = 0;
+    OpenNodes.push_back(OpenNode{ &first, start });
+
+    while (!OpenNodes.empty()) {
+        OpenNode current = heap_pop();
+        if (current.index == end)
+            return true;
+
+        // unit steps and a manhattan estimate, a closed node is never improved on
+        int ci = current.index / size;
+        int cj = current.index % size;
+        int local_goal = current.node->local_goal + 1;
+        for (int k = 0; k < NEIGHBORS_MAX; ++k) {
+            int ni = ci + NeighborI[k];
+            int nj = cj + NeighborJ[k];
+            if (ni < lo_i || ni > hi_i || nj < lo_j || nj > hi_j || !FLR.walkable(ni, nj))
+                continue;
+
+            int next = ni * size + nj;
+            Node& neighbor = Nodes.at(ni, nj);
+            if (neighbor.generation != SearchGeneration) {
+                neighbor.generation = SearchGeneration;
+                neighbor.heap_index = (int)OpenNodes.size();
+                OpenNodes.push_back(OpenNode{ &neighbor, next });
             }
+            else if (neighbor.heap_index == NODE_CLOSED || local_goal >= neighbor.local_goal) {
+                continue;
+            }
+            neighbor.local_goal = local_goal;
+            neighbor.global_goal = local_goal + Node::dist(ni, nj, end_i, end_j);
+            neighbor.parent = current.index;
+            heap_up(neighbor.heap_index);
         }
     }
+    return false;
+}
+
+void astar_path(int end_i, int end_j, std::vector<int> *out)
+{
+    size_t first = out->size();
+    for (int n = end_i * FLR.size + end_j; node_at(n).parent != -1; n = node_at(n).parent)
+        out->push_back(n);
+    std::reverse(out->begin() + first, out->end());
 }
 
-void astar_walk(int *start_i, int *start_j, int end_i, int end_j)
+void flow_invalidate()
 {
-    astar_solve(*start_i, *start_j, end_i, end_j);
+    FlowTarget = -1;
+}
 
-    // find next adjacent square to walk to
-    for (Node *n = &Nodes[end_i][end_j]; n->parent; n = n->parent) {
-        if (!n->parent->parent) {
-            *start_i = n->y;
-            *start_j = n->x;
+void flow_update(int target_i, int target_j)
+{
+    PROF_ZONE("flow_update");
+    int size = FLR.size;
+    int target = target_i * size + target_j;
+    if (target == FlowTarget)
+        return;
+
+    bool stepped = FlowTarget >= 0 && FlowOffset < FLOW_OFFSET_MAX
+        && Node::dist(FlowTarget / size, FlowTarget % size, target_i, target_j) == 1;
+    if (stepped) {
+        // one step moves no distance up by more than one, so the old distances
+        // plus one are upper bounds, all that's left is spreading decreases
+        // from the new target
+        FlowOffset += 1;
+    }
+    else {
+        FlowField.resize(size, size, FLOW_UNREACHED);
+        FlowOffset = 0;
+    }
+    FlowTarget = target;
+
+    // breadth first, a tile is only queued the one time its distance drops
+    FlowField.set(target_i, target_j, -FlowOffset);
+    FlowQueue.clear();
+    FlowQueue.push_back(target);
+    for (size_t head = 0; head < FlowQueue.size(); ++head) {
+        int ci = FlowQueue[head] / size;
+        int cj = FlowQueue[head] % size;
+        int value = FlowField.get(ci, cj) + 1;
+        for (int k = 0; k < NEIGHBORS_MAX; ++k) {
+            int ni = ci + NeighborI[k];
+            int nj = cj + NeighborJ[k];
+            if (ni < 0 || ni >= size || nj < 0 || nj >= size || !FLR.walkable(ni, nj))
+                continue;
+            int& distance = FlowField.at(ni, nj);
+            if (distance <= value)
+                continue;
+            distance = value;
+            FlowQueue.push_back(ni * size + nj);
         }
     }
 }
 
+int flow_distance(int i, int j)
+{
+    int distance = FlowField.get(i, j);
+    if (distance == FLOW_UNREACHED)
+        return FLOW_UNREACHED;
+    return distance + FlowOffset;
+}
+
+bool flow_step(int *i, int *j)
+{
+    int best = FlowField.get(*i, *j);
+    int best_k = -1;
+    for (int k = 0; k < NEIGHBORS_MAX; ++k) {
+        int ni = *i + NeighborI[k];
+        int nj = *j + NeighborJ[k];
+        if (!FlowField.contains(ni, nj))
+            continue;
+        if (FlowField.get(ni, nj) < best) {
+            best = FlowField.get(ni, nj);
+            best_k = k;
+        }
+    }
+    if (best_k < 0)
+        return false;
+    *i += NeighborI[best_k];
+    *j += NeighborJ[best_k];
+    return true;
+}
+
 void entity_move(int direction)
 {
     enemy_move();
@@ -226,28 +410,82 @@ void entity_move(int direction)
 
 void player_move(int direction)
 {
+    int i = Player.map_y;
+    int j = Player.map_x;
     Player.move(direction);
-    FLR.Graph[Player.graph_y][Player.graph_x].is_explored = true;
+    if (Player.map_y != i || Player.map_x != j) {
+        vacate(FLR, i, j);
+        occupy(FLR, Player.map_y, Player.map_x);
+    }
+    Room& room = FLR.room(Player.graph_y, Player.graph_x);
+    if (!room.is_explored) {
+        room.is_explored = true;
+        map_layer_invalidate_room(Player.graph_y, Player.graph_x);
+    }
 }
 
 void enemy_move()
 {
-    for (int i = 0; i < ENTITY_MAX; ++i) {
-        if (!Entities[i] || !Entities[i]->is_enemy)
+    PROF_ZONE("enemy_move");
+    // every enemy heads for the player, one search serves them all
+    flow_update(Player.map_y, Player.map_x);
+    EntityPool& pool = FLR.Entities;
+    for (int k = 0; k < pool.size(); ++k) {
+        if (pool.id[k] != ID_ENEMY)
+            continue;
+
+        int tmp_y = pool.map_y[k];
+        int tmp_x = pool.map_x[k];
+        if (!flow_step(&tmp_y, &tmp_x))
             continue;
-        
-        int tmp_y = Entities[i]->map_y;
-        int tmp_x = Entities[i]->map_x;
-        astar_walk(&tmp_y, &tmp_x, Player.map_y, Player.map_x);
 
         // ensure there is a spot to walk to
         if (empty_coords(tmp_y, tmp_x)) {
-            Entities[i]->map_x = tmp_x;
-            Entities[i]->map_y = tmp_y;
-            Entities[i]->graph_x = map_to_graph_index(Entities[i]->map_x);
-            Entities[i]->graph_y = map_to_graph_index(Entities[i]->map_y);
+            vacate(FLR, pool.map_y[k], pool.map_x[k]);
+            occupy(FLR, tmp_y, tmp_x);
+            pool.map_y[k] = tmp_y;
+            pool.map_x[k] = tmp_x;
+            pool.graph_y[k] = map_to_graph_index(tmp_y);
+            pool.graph_x[k] = map_to_graph_index(tmp_x);
         }
     }
 }
 
-}
\ No newline at end of file
+/**
+ * Travel
+ */
+
+bool travel_start(int end_i, int end_j)
+{
+    // the map doesn't change under a floor's walls, one plan serves the whole walk
+    TravelStep = 0;
+    if (!hpa_solve(Player.map_y, Player.map_x, end_i, end_j, &TravelPath))
+        TravelPath.clear();
+    return !TravelPath.empty();
+}
+
+bool travel_step()
+{
+    if (TravelStep >= TravelPath.size())
+        return false;
+    int i = TravelPath[TravelStep] / FLR.size;
+    int j = TravelPath[TravelStep] % FLR.size;
+    TravelStep += 1;
+    if (i < Player.map_y)
+        entity_move(UP);
+    else if (j > Player.map_x)
+        entity_move(RIGHT);
+    else if (i > Player.map_y)
+        entity_move(DOWN);
+    else
+        entity_move(LEFT);
+    return TravelStep < TravelPath.size();
+}
+
+void travel_stop()
+{
+    TravelPath.clear();
+    TravelStep = 0;
+}
+
+}
@@ -4,24 +4,40 @@
 
 namespace Modules {
 
-void entity_insert(Entity *e);
-void rand_room_tile(int gi, int gj, int *i, int *j); // get a random tile within the room at the grid coord
-void rand_room_tile_no_overlap(int gi, int gj, int *i, int *j); // get a random tile within the room at the grid coord
-bool empty_coords(int i, int j); // true if there is another entity on the given coordinates
+// stairs and entities standing on each tile of a floor, every room block
+// keeps the walkable tiles nobody stands on in a list from the first pick
+// on so a free tile is found in O(1) however crowded the floor gets
+void occupy(Floor& floor, int i, int j); // one more entity stands on the tile
+void vacate(Floor& floor, int i, int j); // one less, after a move or on leaving the floor
+bool rand_room_free_tile(Floor& floor, Rng& rng, int gi, int gj, int *i, int *j); // even pick in the room's block, false if it's full
+bool empty_coords(int i, int j); // true if nothing stands on the given coordinates of the current floor
+bool floor_coords_empty(const Floor& floor, int i, int j); // same for any floor
 
-void spawn_entities(); // spawn all entities onto the Map
+void spawn_entities(); // bring the player onto the current floor
 void spawn_player(); // spawn player at center of Start_i/j
-void spawn_stairs(); // spawn stairs at center of End_i/j
-void spawn_enemies(); // at random locations
+void spawn_stairs(Floor& floor, Rng& rng); // spawn stairs in the Start and End rooms, part of generating the floor
+void spawn_enemies(Floor& floor, Rng& rng); // at random locations, part of generating the floor
 
 // A* https://www.youtube.com/watch?v=icZj67PTFhc
 void astar_init();
-void astar_reset();
-void astar_solve(int start_i, int start_j, int end_i, int end_j);
-void astar_walk(int *start_i, int *start_j, int end_i, int end_j);
+void astar_reset(); // start a new search, O(1) unless the generation wraps
+bool astar_solve(int start_i, int start_j, int end_i, int end_j); // false if end can't be reached
+bool astar_solve_in(int start_i, int start_j, int end_i, int end_j, int lo_i, int lo_j, int hi_i, int hi_j); // only tiles in the inclusive bounds
+void astar_path(int end_i, int end_j, std::vector<int> *out); // append the last solved path, after start up to end
+
+// distances from every tile to one target, shared by all enemies
+void flow_update(int target_i, int target_j); // incremental when the target moved one tile
+void flow_invalidate(); // the map changed, next update rebuilds
+bool flow_step(int *i, int *j); // one tile closer to the target, false if there's none
+int flow_distance(int i, int j); // FLOW_UNREACHED if the target can't be reached
 
 void entity_move(int direction); // move player in direction and all other entities
 void player_move(int direction);
 void enemy_move();
 
+// walk the player somewhere far one step per update, planned once by HPA*
+bool travel_start(int end_i, int end_j); // false if end can't be reached or the player is there
+bool travel_step(); // move along the plan, false once it's walked
+void travel_stop();
+
 }
\ No newline at end of file
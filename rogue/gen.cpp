@@ -1,16 +1,29 @@
+#include <algorithm>
+#include <condition_variable>
 #include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
 
 #include "../../pse.hpp"
+#include "../prof/zones.hpp"
+#include "cave.hpp"
+#include "draw.hpp"
+#include "dungeon.hpp"
 #include "entity.hpp"
 #include "gen.hpp"
 #include "globals.hpp"
+#include "path.hpp"
+#include "save.hpp"
 #include "types.hpp"
 
 namespace Modules {
 
 int map_to_graph_index(int index)
 {
-    return index / ROOM_WIDTH;
+    return FLR.block_of(index);
 }
 
 int graph_to_map_index(int index)
@@ -18,64 +31,74 @@ int graph_to_map_index(int index)
     return index * ROOM_WIDTH + ROOM_WIDTH / 2;
 }
 
+int graph_to_map_lo(int index)
+{
+    return FLR.block_lo(index);
+}
+
+int graph_to_map_hi(int index)
+{
+    return FLR.block_hi(index);
+}
+
 bool coords_equal(int i0, int j0, int i1, int j1)
 {
     return i0 == i1 && j0 == j1;
 }
 
-bool up_try_insert(int i, int j)
+bool up_try_insert(Floor& floor, int i, int j)
 {
-    if (i - 1 >= 0 && FLR.Graph[i - 1][j].index < NEIGHBORS_MAX - 1) {
-        FLR.Graph[i][j].insert_neighbor(UP);
-        FLR.Graph[i - 1][j].insert_neighbor(DOWN);
+    if (i - 1 >= 0 && floor.room(i - 1, j).index < NEIGHBORS_MAX - 1) {
+        floor.room(i, j).insert_neighbor(UP);
+        floor.room(i - 1, j).insert_neighbor(DOWN);
         return true;
     }
     return false;
 }
 
-bool right_try_insert(int i, int j)
+bool right_try_insert(Floor& floor, int i, int j)
 {
-    if (j + 1 < GRAPH_SIZE && FLR.Graph[i][j + 1].index < NEIGHBORS_MAX - 1) {
-        FLR.Graph[i][j].insert_neighbor(RIGHT);
-        FLR.Graph[i][j + 1].insert_neighbor(LEFT);
+    if (j + 1 < floor.graph_size && floor.room(i, j + 1).index < NEIGHBORS_MAX - 1) {
+        floor.room(i, j).insert_neighbor(RIGHT);
+        floor.room(i, j + 1).insert_neighbor(LEFT);
         return true;
     }
     return false;
 }
 
-bool down_try_insert(int i, int j)
+bool down_try_insert(Floor& floor, int i, int j)
 {
-    if (i + 1 < GRAPH_SIZE && FLR.Graph[i + 1][j].index < NEIGHBORS_MAX - 1) {
-        FLR.Graph[i][j].insert_neighbor(DOWN);
-        FLR.Graph[i + 1][j].insert_neighbor(UP);
+    if (i + 1 < floor.graph_size && floor.room(i + 1, j).index < NEIGHBORS_MAX - 1) {
+        floor.room(i, j).insert_neighbor(DOWN);
+        floor.room(i + 1, j).insert_neighbor(UP);
         return true;
     }
     return false;
 }
 
-bool left_try_insert(int i, int j)
+bool left_try_insert(Floor& floor, int i, int j)
 {
-    if (j - 1 >= 0 && FLR.Graph[i][j - 1].index < NEIGHBORS_MAX - 1) {
-        FLR.Graph[i][j].insert_neighbor(LEFT);
-        FLR.Graph[i][j - 1].insert_neighbor(RIGHT);
+    if (j - 1 >= 0 && floor.room(i, j - 1).index < NEIGHBORS_MAX - 1) {
+        floor.room(i, j).insert_neighbor(LEFT);
+        floor.room(i, j - 1).insert_neighbor(RIGHT);
         return true;
     }
     return false;
 }
 
-bool room_try_insert(int *out_direction, int i, int j)
+bool room_try_insert(Floor& floor, Rng& rng, int *out_direction, int i, int j)
 {
     // randomly select a direction that was not yet chosen
     do {
-        *out_direction = rand_range(0, NEIGHBORS_MAX);
-    } while (FLR.Graph[i][j].check_neighbor(*out_direction));
+        *out_direction = rng.range(0, NEIGHBORS_MAX);
+    } while (floor.room(i, j).check_neighbor(*out_direction));
 
     // attempt to connect to the direction
     switch (*out_direction) {
-        case UP:    return up_try_insert(i, j);
-        case RIGHT: return right_try_insert(i, j);
-        case DOWN:  return down_try_insert(i, j);
-        case LEFT:  return left_try_insert(i, j);
+        case UP:    return up_try_insert(floor, i, j);
+        case RIGHT: return right_try_insert(floor, i, j);
+        case DOWN:  return down_try_insert(floor, i, j);
+        case LEFT:  return left_try_insert(floor, i, j);
         default:
             fprintf(stderr, "Error: Invalid room choice: %d\n", *out_direction);
             exit(-1);
@@ -84,40 +107,33 @@ bool room_try_insert(int *out_direction, int i, int j)
     // out variable direction can be recorded
 };
 
-bool graph_has_unconnected_neighbors_at(int i, int j)
+bool graph_has_unconnected_neighbors_at(Floor& floor, int i, int j)
 {
     bool connected = false;
 
     // bounds check before checking neighbors
-    if (i - 1 >= 0)         connected = connected || !FLR.Graph[i - 1][j].is_connected;
-    if (i + 1 < GRAPH_SIZE) connected = connected || !FLR.Graph[i + 1][j].is_connected;
-    if (j - 1 >= 0)         connected = connected || !FLR.Graph[i][j - 1].is_connected;
-    if (j + 1 < GRAPH_SIZE) connected = connected || !FLR.Graph[i][j + 1].is_connected;
+    if (i - 1 >= 0)         connected = connected || !floor.room(i - 1, j).is_connected;
+    if (i + 1 < floor.graph_size) connected = connected || !floor.room(i + 1, j).is_connected;
+    if (j - 1 >= 0)         connected = connected || !floor.room(i, j - 1).is_connected;
+    if (j + 1 < floor.graph_size) connected = connected || !floor.room(i, j + 1).is_connected;
     
     return connected;
 }
 
-void gen_graph()
+void gen_graph(Floor& floor, Rng& rng)
 {
-    // clear global Graph
-    for (int i = 0; i < GRAPH_SIZE; ++i) {
-        for (int j = 0; j < GRAPH_SIZE; ++j) {
-            FLR.Graph[i][j] = Room{};
-        }
-    }
-
     // pick a random room to start with (for random walk and player spawn)
-    int curr_i = rand_range(0, GRAPH_SIZE);
-    int curr_j = rand_range(0, GRAPH_SIZE);
-    FLR.Graph[curr_i][curr_j].is_connected = true;
-    FLR.Start_i = curr_i; FLR.Start_j = curr_j;
+    int curr_i = rng.range(0, floor.graph_size);
+    int curr_j = rng.range(0, floor.graph_size);
+    floor.room(curr_i, curr_j).is_connected = true;
+    floor.Start_i = curr_i; floor.Start_j = curr_j;
 
     // connect unconnected neighbors, change the state of direction
     int direction; // direction is modified within room_try_insert
 
     // random walk across the graph until blocked or finished (no backtracking)
-    while (graph_has_unconnected_neighbors_at(curr_i, curr_j)) {
-        if (room_try_insert(&direction, curr_i, curr_j)) {
+    while (graph_has_unconnected_neighbors_at(floor, curr_i, curr_j)) {
+        if (room_try_insert(floor, rng, &direction, curr_i, curr_j)) {
             switch (direction) {
                 case UP:    curr_i -= 1; break;
                 case RIGHT: curr_j += 1; break;
@@ -130,16 +146,16 @@ void gen_graph()
         }
     }
     // record stair room
-    FLR.End_i = curr_i; FLR.End_j = curr_j;
+    floor.End_i = curr_i; floor.End_j = curr_j;
 
     // connect any still unconnected rooms with at least 2 neighbors, prevent dead room connections
-    for (int i = 0; i < GRAPH_SIZE; ++i) {
-        for (int j = 0; j < GRAPH_SIZE; ++j) {
-            if (!FLR.Graph[i][j].is_connected) {
+    for (int i = 0; i < floor.graph_size; ++i) {
+        for (int j = 0; j < floor.graph_size; ++j) {
+            if (!floor.room(i, j).is_connected) {
                 int tries = 0;
-                while (FLR.Graph[i][j].index < 2) {
+                while (floor.room(i, j).index < 2) {
                     // direction still passed, but not needed
-                    room_try_insert(&direction, i, j);
+                    room_try_insert(floor, rng, &direction, i, j);
                     if (tries++ > ROOM_CONNECT_TRIES)
                         break;
                 }
@@ -148,84 +164,210 @@ void gen_graph()
     }
 }
 
-void gen_map()
+void gen_map(Floor& floor, Rng& rng)
 {
-    // create map of just walls
-    for (int i = 0; i < MAP_SIZE; ++i) {
-        for (int j = 0; j < MAP_SIZE; ++j) {
-            FLR.Map[i][j] = WALL;
-        }
-    }
+    // create map of just walls, chunks are only allocated once something is carved into them
+    floor.fill_rock();
 
     // draw rooms and their doors for each node in the graph into the Map
-    for (int i = 0; i < GRAPH_SIZE; ++i) {
-        for (int j = 0; j < GRAPH_SIZE; ++j) {
-            // ignore empty nodes
-            if (FLR.Graph[i][j].index == 0)
+    for (int i = 0; i < floor.graph_size; ++i) {
+        for (int j = 0; j < floor.graph_size; ++j) {
+            // ignore empty nodes, the start room is kept even when it's the only one
+            if (!floor.room(i, j).is_connected)
                 continue;
 
             // random room width and height relative to the map
-            FLR.Graph[i][j].map_w = rand_range(ROOM_TOLERANCE, ROOM_WIDTH);
-            FLR.Graph[i][j].map_h = rand_range(ROOM_TOLERANCE, ROOM_WIDTH);
-            FLR.Graph[i][j].map_i = i * ROOM_WIDTH;
-            FLR.Graph[i][j].map_j = j * ROOM_WIDTH;
-            FLR.Graph[i][j].center_i = i * ROOM_WIDTH + ROOM_WIDTH / 2;
-            FLR.Graph[i][j].center_j = j * ROOM_WIDTH + ROOM_WIDTH / 2;
+            floor.room(i, j).map_w = rng.range(ROOM_TOLERANCE, ROOM_WIDTH);
+            floor.room(i, j).map_h = rng.range(ROOM_TOLERANCE, ROOM_WIDTH);
+            floor.room(i, j).map_i = i * ROOM_WIDTH;
+            floor.room(i, j).map_j = j * ROOM_WIDTH;
+            floor.room(i, j).center_i = i * ROOM_WIDTH + ROOM_WIDTH / 2;
+            floor.room(i, j).center_j = j * ROOM_WIDTH + ROOM_WIDTH / 2;
 
             // temp alias
-            int& room_w = FLR.Graph[i][j].map_w;
-            int& room_h = FLR.Graph[i][j].map_h;
-            int& room_i = FLR.Graph[i][j].map_i;
-            int& room_j = FLR.Graph[i][j].map_j;
-            int& center_i = FLR.Graph[i][j].center_i;
-            int& center_j = FLR.Graph[i][j].center_j;
-
-            // skip filling room area if a gone room is to be used
-            if (rand_uniform() < ROOM_GONE_CHANCE) {
-                FLR.Graph[i][j].is_gone = true;
+            int& room_w = floor.room(i, j).map_w;
+            int& room_h = floor.room(i, j).map_h;
+            int& room_i = floor.room(i, j).map_i;
+            int& room_j = floor.room(i, j).map_j;
+            int& center_i = floor.room(i, j).center_i;
+            int& center_j = floor.room(i, j).center_j;
+
+            // skip filling room area if a gone room is to be used, it needs a corridor to be left with
+            if (floor.room(i, j).index > 0 && rng.uniform() < ROOM_GONE_CHANCE) {
+                floor.room(i, j).is_gone = true;
                 goto create_corridor;
             }
 
             // fill room area with floor
             for (int ri = room_i + room_h / ROOM_TOLERANCE; ri < room_i + room_h; ++ri) {
                 for (int rj = room_j + room_w / ROOM_TOLERANCE; rj < room_j + room_w; ++rj) {
-                    FLR.Map[ri][rj] = FLOOR;
+                    floor.set_tile(ri, rj, FLOOR);
                 }
             }
 
 create_corridor:
             // walk towards door in each direction from room center if it has a door that way
-            if (FLR.Graph[i][j].check_neighbor(DOWN)) {
+            if (floor.room(i, j).check_neighbor(DOWN)) {
                 for (int ci = center_i; ci < i * ROOM_WIDTH + ROOM_WIDTH * ROOM_PATH_MODIFIER; ++ci)
-                    FLR.Map[ci][center_j] = FLOOR;
+                    floor.set_tile(ci, center_j, FLOOR);
             }
-            if (FLR.Graph[i][j].check_neighbor(UP)) {
+            if (floor.room(i, j).check_neighbor(UP)) {
                 for (int ci = center_i; ci > i * ROOM_WIDTH - ROOM_WIDTH * ROOM_PATH_MODIFIER; --ci)
-                    FLR.Map[ci][center_j] = FLOOR;
+                    floor.set_tile(ci, center_j, FLOOR);
             }
-            if (FLR.Graph[i][j].check_neighbor(RIGHT))
+            if (floor.room(i, j).check_neighbor(RIGHT))
                 for (int cj = center_j; cj < j * ROOM_WIDTH + ROOM_WIDTH * ROOM_PATH_MODIFIER; ++cj)
-                    FLR.Map[center_i][cj] = FLOOR;
-            if (FLR.Graph[i][j].check_neighbor(LEFT))
+                    floor.set_tile(center_i, cj, FLOOR);
+            if (floor.room(i, j).check_neighbor(LEFT))
                 for (int cj = center_j; cj > j * ROOM_WIDTH - ROOM_WIDTH * ROOM_PATH_MODIFIER; --cj)
-                    FLR.Map[center_i][cj] = FLOOR;
+                    floor.set_tile(center_i, cj, FLOOR);
         }
     }
 
     // draw surrounding border wall around entire map
-    for (int i = 0; i < MAP_SIZE; ++i) {
-        for (int j = 0; j < MAP_SIZE; ++j) {
-            if (i == 0 || i == MAP_SIZE - 1 || j == 0 || j == MAP_SIZE - 1)
-                FLR.Map[i][j] = WALL;
+    for (int k = 0; k < floor.size; ++k) {
+        floor.set_tile(0, k, WALL);
+        floor.set_tile(floor.size - 1, k, WALL);
+        floor.set_tile(k, 0, WALL);
+        floor.set_tile(k, floor.size - 1, WALL);
+    }
+}
+
+void gen_open_tiles(Floor& floor)
+{
+    for (int i = 0; i < floor.graph_size; ++i) {
+        for (int j = 0; j < floor.graph_size; ++j) {
+            floor.room(i, j).open_tiles = floor.Walkable.count(floor.block_lo(i), floor.block_lo(j),
+                floor.block_hi(i), floor.block_hi(j));
         }
     }
 }
 
-void gen_floor()
+uint64_t floor_seed(int level)
 {
-    gen_graph();
-    gen_map();
+    return Rng(DungeonSeed + (uint64_t)level * 0x9e3779b97f4a7c15ull).next();
+}
+
+void gen_floor(Floor& floor, int size, int generator, uint64_t seed)
+{
+    PROF_ZONE("gen_floor");
+    Rng rng(seed);
+    // clear the Graph, sized for the floor about to be made
+    floor.resize(size);
+    floor.seed = seed;
+    if (generator == GEN_CAVES) {
+        gen_caves(floor, rng);
+    }
+    else {
+        gen_graph(floor, rng);
+        gen_map(floor, rng);
+    }
+    gen_open_tiles(floor);
+    hpa_build(floor);
+    spawn_stairs(floor, rng);
+    spawn_enemies(floor, rng);
+    floor.visited = true;
+}
+
+/**
+ * Pregeneration
+ */
+
+// the floor below, made on a worker thread while the player walks this one.
+// The thread stays up between floors and takes one floor at a time
+struct Pregen {
+    std::thread thread;
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::unique_ptr<Floor> floor;
+    int level = -1; // floor in flight or done, -1 for none
+    int size = 0;
+    int generator = GEN_ROOMS;
+    uint64_t seed = 0;
+    bool busy = false;
+    bool quit = false;
+
+    ~Pregen() {
+        if (!this->thread.joinable())
+            return;
+        {
+            std::lock_guard<std::mutex> lock(this->mutex);
+            this->quit = true;
+        }
+        this->cv.notify_all();
+        this->thread.join();
+    }
+};
+
+static Pregen Next;
+
+static void pregen_run()
+{
+    prof::zone_thread_name("rogue worker");
+    std::unique_lock<std::mutex> lock(Next.mutex);
+    for (;;) {
+        Next.cv.wait(lock, []() { return Next.busy || Next.quit; });
+        if (Next.quit)
+            return;
+        lock.unlock();
+        gen_floor(*Next.floor, Next.size, Next.generator, Next.seed);
+        lock.lock();
+        Next.busy = false;
+        Next.cv.notify_all();
+    }
+}
+
+// wait for the floor in flight, into the dungeon if keep
+static void pregen_finish(bool keep)
+{
+    if (Next.level < 0)
+        return;
+    {
+        std::unique_lock<std::mutex> lock(Next.mutex);
+        Next.cv.wait(lock, []() { return !Next.busy; });
+    }
+    if (keep)
+        dungeon_insert(Next.level, std::move(Next.floor));
+    Next.floor.reset();
+    Next.level = -1;
+}
+
+void floor_pregenerate(int level)
+{
+    if (dungeon_has(level))
+        return;
+    if (Next.level == level && Next.size == FloorSize && Next.generator == FloorGenerator)
+        return;
+    // settings changed since it was started, throw it away
+    pregen_finish(false);
+
+    {
+        std::lock_guard<std::mutex> lock(Next.mutex);
+        Next.level = level;
+        Next.size = FloorSize;
+        Next.generator = FloorGenerator;
+        Next.seed = floor_seed(level);
+        Next.floor.reset(new Floor{});
+        Next.busy = true;
+    }
+    if (!Next.thread.joinable())
+        Next.thread = std::thread(pregen_run);
+    Next.cv.notify_all();
+}
+
+void floor_enter()
+{
+    flow_invalidate();
+    travel_stop();
+    map_layer_invalidate();
     spawn_entities();
+    floor_pregenerate(FloorLevel + 1);
+}
+
+void floor_regenerate()
+{
+    gen_floor(FLR, FloorSize, FloorGenerator, (uint64_t)rand() << 32 ^ (uint64_t)rand());
+    floor_enter();
 }
 
 void floor_switch(int direction)
@@ -242,22 +384,23 @@ void floor_switch(int direction)
         }
         break;
     case DOWN:
-        if (FloorLevel + 1 < FLOORS_MAX) {
-            FloorLevel++;
-            LastStairDirection = UP;
-            if (!FLR.visited)
-                gen_floor();
-        }
-        else
-            printf("You've explored all rooms!\n");
+        FloorLevel++;
+        LastStairDirection = UP;
+        if (Next.level == FloorLevel)
+            pregen_finish(true);
         break;
     default:
         fprintf(stderr, "Error: Invalid floor switch %d\n", direction);
         exit(-1);
     }
-    spawn_entities();
+    // the floor left behind is kept without the player on it
+    vacate(FLR, Player.map_y, Player.map_x);
+    // resident, loaded from its file or generated on the spot
+    CurrentFloor = &dungeon_floor(FloorLevel);
+    floor_enter();
+    dungeon_save_state();
 
-    printf("Floor: %d\n", FloorLevel);
+    printf("Floor: %d (seed %016llx)\n", FloorLevel, (unsigned long long)FLR.seed);
 }
 
 }
@@ -1,7 +1,12 @@
 #pragma once
 
+#include <cstdint>
+
 namespace Modules {
 
+struct Floor;
+struct Rng;
+
 /******************************************************************************
  * Floor Generation
  * 
@@ -9,20 +14,31 @@ namespace Modules {
  * 
  */
 
+// tile and block coordinates on the current floor, the Floor block_* methods for any other
 int map_to_graph_index(int index);
 int graph_to_map_index(int index);
+int graph_to_map_lo(int index); // first tile of a room's block along one axis
+int graph_to_map_hi(int index); // last tile of a room's block along one axis, inclusive
 bool coords_equal(int i0, int j0, int i1, int j1);
 
-void gen_graph(); // generate a set of rooms from globals, write data structure into the global 'Graph'
-bool graph_has_unconnected_neighbors_at(int i, int j);  // return true if a room has at least 1 unconnected neighbor
-bool room_try_insert(int *out_direction, int i, int j); // use try_insert fns to randomly connect a room
-bool up_try_insert(int i, int j);    // try to make room connection up, return false on fail
-bool right_try_insert(int i, int j); // try to make room connection right, return false on fail
-bool down_try_insert(int i, int j);  // try to make room connection down, return false on fail
-bool left_try_insert(int i, int j);  // try to make room connection left, return false on fail
+// generators write only the floor they're given and draw only from rng, so
+// a floor can be made on any thread and again from its seed
+void gen_graph(Floor& floor, Rng& rng); // generate a set of rooms, write data structure into the floor's 'Graph'
+bool graph_has_unconnected_neighbors_at(Floor& floor, int i, int j);  // return true if a room has at least 1 unconnected neighbor
+bool room_try_insert(Floor& floor, Rng& rng, int *out_direction, int i, int j); // use try_insert fns to randomly connect a room
+bool up_try_insert(Floor& floor, int i, int j);    // try to make room connection up, return false on fail
+bool right_try_insert(Floor& floor, int i, int j); // try to make room connection right, return false on fail
+bool down_try_insert(Floor& floor, int i, int j);  // try to make room connection down, return false on fail
+bool left_try_insert(Floor& floor, int i, int j);  // try to make room connection left, return false on fail
+
+void gen_map(Floor& floor, Rng& rng); // generate the map from the graph of the floor
+void gen_open_tiles(Floor& floor); // count the walkable tiles of every room's block
+uint64_t floor_seed(int level); // seed of a level, from DungeonSeed
+void gen_floor(Floor& floor, int size, int generator, uint64_t seed); // generate entire floor from subroutines
 
-void gen_map(); // generate the map from the graph of the floor
-void gen_floor(); // generate entire floor from subroutines
+void floor_pregenerate(int level); // start making level on a worker thread if it isn't resident or saved
+void floor_enter(); // spawn onto the current floor and start on the one below
+void floor_regenerate(); // replace the current floor with one from a new seed
 void floor_switch(int direction); // switch to a different floor
 
 }
\ No newline at end of file
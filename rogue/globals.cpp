@@ -2,23 +2,41 @@
 #include "globals.hpp"
 #include "types.hpp"
 
-#include <deque>
+#include <vector>
 
 namespace Modules {
 
 pse::Context *PSE_Context;
 
+int FloorSize = MAP_SIZE;
+int FloorGenerator = GEN_ROOMS;
+int ViewTop = 0;
+int ViewLeft = 0;
+int ViewRows = 0;
+int ViewCols = 0;
+
 Entity Player{};
 bool PlayerCanMove = true;
-Entity *Entities[ENTITY_MAX];
-int EntityIndex = 0;
+std::vector<int> TravelPath;
+size_t TravelStep = 0;
+int EnemyCount = 0;
 
 // A* util
-Node Nodes[MAP_SIZE][MAP_SIZE];
-std::deque<Node *> UntestedNodes;
+ChunkGrid<Node> Nodes;
+std::vector<OpenNode> OpenNodes;
+uint32_t SearchGeneration = 0;
+
+// flow field
+ChunkGrid<int> FlowField;
+int FlowOffset = 0;
+int FlowTarget = -1;
+std::vector<int> FlowQueue;
 
-Floor Dungeon[FLOORS_MAX];
+Floor *CurrentFloor = nullptr;
 int FloorLevel = 0;
+uint64_t DungeonSeed = 0;
+int FloorsResident = FLOORS_RESIDENT;
+const char *SaveDir = "rogue_save";
 int LastStairDirection = UP;
 
 int SpritePlayerId = 0;
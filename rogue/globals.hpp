@@ -1,25 +1,42 @@
 #pragma once
 
-#include <deque>
+#include <cstdint>
+#include <vector>
 
 namespace Modules {
 
-constexpr int GRAPH_SIZE = 4;
-constexpr int MAP_SIZE = 60;    // ~10x GRAPH_SIZE is good
+constexpr int MAP_SIZE = 60; // default side of a floor in tiles, ROGUE_MAP_SIZE overrides
+constexpr int MAP_SIZE_MIN = 16;
+constexpr int MAP_SIZE_MAX = 16384; // flat tile indices stay in an int
 
-// the number of tiles square of each room
-constexpr int ROOM_WIDTH = MAP_SIZE / GRAPH_SIZE - 1;
+// tile storage is allocated in CHUNK_SIZE square chunks as they're written
+constexpr int CHUNK_BITS = 5;
+constexpr int CHUNK_SIZE = 1 << CHUNK_BITS;
+constexpr int CHUNK_MASK = CHUNK_SIZE - 1;
+constexpr int MAP_LAYER_CHUNKS = 32; // chunk textures of drawn tiles kept around the camera
+
+// the number of tiles square of each room, a floor has (size - 2) / ROOM_WIDTH rooms a side
+constexpr int ROOM_WIDTH = 14;
 constexpr int ROOM_TOLERANCE = ROOM_WIDTH / 2;
 constexpr int ROOM_CONNECT_TRIES = 7;
 #define ROOM_PATH_MODIFIER 2 / 3 /* INTENDS TO HAVE OPERATOR PRECEDENCE MAKE LHS RVALUE GREATER THAN RHS */
 constexpr float ROOM_GONE_CHANCE = 0.05f;
 
+// cave floors: rock seeded at CAVE_FILL sixteenths, smoothed over CAVE_STEPS automaton steps
+constexpr int CAVE_FILL = 7;
+constexpr int CAVE_STEPS = 5;
+constexpr int CAVE_TRIES = 8; // reseeds while the largest cave is under a quarter of the floor
+
 constexpr int TILE_SCALING = 95; // tile size modifier on SDL window
 constexpr int TILE_WIDTH = TILE_SCALING / 7;
 
-constexpr int ENTITY_MAX = 40; // maximum number of entities
-constexpr int FLOORS_MAX = 20; // maximum number of floor
+constexpr int FLOORS_RESIDENT = 4; // floors kept in memory, ROGUE_RESIDENT_FLOORS overrides
+constexpr int FLOORS_RESIDENT_MIN = 2; // the current floor and the one pregenerated below it
 constexpr int NEIGHBORS_MAX = 4; // Don't touchs
+constexpr int NODE_CLOSED = -1;
+constexpr int PATH_CHECK_SAMPLES = 200; // pairs the V key checks, ROGUE_CHECK_PATHS sets its own
+constexpr int FLOW_UNREACHED = 0x7fffffff;
+constexpr int FLOW_OFFSET_MAX = 1 << 30; // rebuild the flow field before the offset gets near overflow
 
 constexpr int ENEMY_MAX = 10;
 constexpr int ENEMY_MIN = 5;
@@ -30,6 +47,11 @@ enum MapTile {
     EMPTY = ' ',
 };
 
+enum Generator {
+    GEN_ROOMS,
+    GEN_CAVES,
+};
+
 enum Direction {
     UP,
     RIGHT,
@@ -46,26 +68,45 @@ enum EntityId {
 };
 
 struct Node;
+struct OpenNode;
 struct Room;
 struct Entity;
 struct Floor;
+template <typename T> struct ChunkGrid;
+struct BitGrid;
 
 extern pse::Context *PSE_Context;
 
+extern int FloorSize; // side of floors generated from now on
+extern int FloorGenerator; // Generator of floors generated from now on
+extern int ViewTop, ViewLeft, ViewRows, ViewCols; // tiles on screen
+
 extern Entity Player;
 extern bool PlayerCanMove;
-extern Entity *Entities[ENTITY_MAX];
-extern int EntityIndex;
+extern std::vector<int> TravelPath; // tiles the player still has to travel, flat indices
+extern size_t TravelStep; // next tile of TravelPath
+extern int EnemyCount; // enemies on floors generated from now on, 0 for ENEMY_MIN up to ENEMY_MAX
 
 // A* util
-extern Node Nodes[MAP_SIZE][MAP_SIZE];
-extern std::deque<Node *> UntestedNodes;
+extern ChunkGrid<Node> Nodes;
+extern std::vector<OpenNode> OpenNodes; // binary heap of the open set
+extern uint32_t SearchGeneration;
+
+// flow field, distance of a tile to FlowTarget is FlowField + FlowOffset
+extern ChunkGrid<int> FlowField;
+extern int FlowOffset;
+extern int FlowTarget; // flat index, -1 when the field is stale
+extern std::vector<int> FlowQueue;
 
-extern Floor Dungeon[FLOORS_MAX];
+extern Floor *CurrentFloor; // resident in the Dungeon cache
 extern int FloorLevel;
+extern uint64_t DungeonSeed; // every level's seed comes from this
 extern int LastStairDirection;
 
-#define FLR Dungeon[FloorLevel]
+extern int FloorsResident;
+extern const char *SaveDir; // floors evicted from memory and the dungeon state, ROGUE_SAVE_DIR overrides
+
+#define FLR (*CurrentFloor)
 
 extern int SpritePlayerId;
 extern int SpriteEnemyId;
@@ -0,0 +1,360 @@
+#include <algorithm>
+#include <climits>
+#include <cstdio>
+#include <cstdint>
+#include <functional>
+#include <queue>
+#include <vector>
+
+#include "../prof/zones.hpp"
+#include "entity.hpp"
+#include "gen.hpp"
+#include "globals.hpp"
+#include "path.hpp"
+#include "types.hpp"
+
+namespace Modules {
+
+static const int StepI[NEIGHBORS_MAX] = { -1, 0, 1, 0 };
+static const int StepJ[NEIGHBORS_MAX] = { 0, 1, 0, -1 };
+
+static int block_index(const Floor& floor, int i, int j)
+{
+    return floor.block_of(i) * floor.graph_size + floor.block_of(j);
+}
+
+int hpa_block(int i, int j)
+{
+    return block_index(FLR, i, j);
+}
+
+/**
+ * Block Search
+ */
+
+struct BlockCell {
+    uint32_t generation;
+    int distance;
+};
+
+// breadth first distances inside one block, stale by generation like Nodes.
+// Per thread, floors below are built on the pregeneration thread
+static thread_local ChunkGrid<BlockCell> BlockCells;
+static thread_local std::vector<int> BlockQueue;
+static thread_local uint32_t BlockGeneration = 0;
+
+static void block_search(const Floor& floor, int i, int j)
+{
+    if (BlockCells.width != floor.size)
+        BlockCells.resize(floor.size, floor.size, BlockCell{ 0, 0 });
+    if (++BlockGeneration == 0) {
+        BlockCells.clear();
+        BlockGeneration = 1;
+    }
+    int size = floor.size;
+    int b = block_index(floor, i, j);
+    int lo_i = floor.block_lo(b / floor.graph_size), hi_i = floor.block_hi(b / floor.graph_size);
+    int lo_j = floor.block_lo(b % floor.graph_size), hi_j = floor.block_hi(b % floor.graph_size);
+
+    BlockQueue.clear();
+    BlockQueue.push_back(i * size + j);
+    BlockCells.at(i, j) = BlockCell{ BlockGeneration, 0 };
+    for (size_t head = 0; head < BlockQueue.size(); ++head) {
+        int ci = BlockQueue[head] / size;
+        int cj = BlockQueue[head] % size;
+        int distance = BlockCells.at(ci, cj).distance + 1;
+        for (int k = 0; k < NEIGHBORS_MAX; ++k) {
+            int ni = ci + StepI[k];
+            int nj = cj + StepJ[k];
+            if (ni < lo_i || ni > hi_i || nj < lo_j || nj > hi_j || !floor.walkable(ni, nj))
+                continue;
+            BlockCell& cell = BlockCells.at(ni, nj);
+            if (cell.generation == BlockGeneration)
+                continue;
+            cell = BlockCell{ BlockGeneration, distance };
+            BlockQueue.push_back(ni * size + nj);
+        }
+    }
+}
+
+// steps from the last block_search start, -1 if it wasn't reached
+static int block_distance(int i, int j)
+{
+    BlockCell cell = BlockCells.get(i, j);
+    return cell.generation == BlockGeneration ? cell.distance : -1;
+}
+
+/**
+ * Graph
+ */
+
+static void add_door_pair(Floor& floor, int ai, int aj, int bi, int bj)
+{
+    PathGraph& graph = floor.Paths;
+    int a = (int)graph.doors.size();
+    graph.doors.push_back(Door{ ai, aj, block_index(floor, ai, aj), {} });
+    graph.doors.push_back(Door{ bi, bj, block_index(floor, bi, bj), {} });
+    graph.doors[a].edges.push_back(DoorEdge{ a + 1, 1 });
+    graph.doors[a + 1].edges.push_back(DoorEdge{ a, 1 });
+    graph.block_doors[graph.doors[a].block].push_back(a);
+    graph.block_doors[graph.doors[a + 1].block].push_back(a + 1);
+}
+
+// walk length tiles from (i, j) along (step_i, step_j), comparing each with
+// the tile across at (across_i, across_j), one door pair mid way along
+// every run open on both sides
+static void scan_boundary(Floor& floor, int i, int j, int step_i, int step_j, int across_i, int across_j, int length)
+{
+    int run = 0;
+    for (int k = 0; k <= length; ++k) {
+        int ti = i + step_i * k;
+        int tj = j + step_j * k;
+        if (k < length && floor.walkable(ti, tj) && floor.walkable(ti + across_i, tj + across_j)) {
+            run += 1;
+            continue;
+        }
+        if (run > 0) {
+            int m = k - run + (run - 1) / 2;
+            int di = i + step_i * m;
+            int dj = j + step_j * m;
+            add_door_pair(floor, di, dj, di + across_i, dj + across_j);
+        }
+        run = 0;
+    }
+}
+
+void hpa_build(Floor& floor)
+{
+    PROF_ZONE("hpa_build");
+    PathGraph& graph = floor.Paths;
+    graph.doors.clear();
+    graph.block_doors.assign((size_t)floor.graph_size * floor.graph_size, std::vector<int>{});
+    graph.segments.clear();
+
+    for (int bi = 0; bi < floor.graph_size; ++bi) {
+        for (int bj = 0; bj < floor.graph_size; ++bj) {
+            if (bj + 1 < floor.graph_size)
+                scan_boundary(floor, floor.block_lo(bi), floor.block_hi(bj), 1, 0, 0, 1,
+                    floor.block_hi(bi) - floor.block_lo(bi) + 1);
+            if (bi + 1 < floor.graph_size)
+                scan_boundary(floor, floor.block_hi(bi), floor.block_lo(bj), 0, 1, 1, 0,
+                    floor.block_hi(bj) - floor.block_lo(bj) + 1);
+        }
+    }
+
+    // doors of a block are joined by their distance without leaving it, a
+    // way round through other blocks is found at the graph level
+    for (size_t a = 0; a < graph.doors.size(); ++a) {
+        Door& door = graph.doors[a];
+        block_search(floor, door.i, door.j);
+        for (int b : graph.block_doors[door.block]) {
+            if (b == (int)a)
+                continue;
+            int cost = block_distance(graph.doors[b].i, graph.doors[b].j);
+            if (cost >= 0)
+                door.edges.push_back(DoorEdge{ b, cost });
+        }
+    }
+    graph.built = true;
+}
+
+/**
+ * Queries
+ */
+
+static std::vector<DoorEdge> StartEdges;
+static std::vector<int> EndCost;
+static std::vector<int> RouteCost;
+static std::vector<int> RoutePrevious;
+
+// doors to pass through from start to end, in order
+static bool hpa_route(int start_i, int start_j, int end_i, int end_j, std::vector<int> *route)
+{
+    PathGraph& graph = FLR.Paths;
+    int door_count = (int)graph.doors.size();
+    int start = door_count;
+    int end = door_count + 1;
+
+    // join start and end to the doors of their blocks
+    block_search(FLR, start_i, start_j);
+    StartEdges.clear();
+    for (int d : graph.block_doors[hpa_block(start_i, start_j)]) {
+        int cost = block_distance(graph.doors[d].i, graph.doors[d].j);
+        if (cost >= 0)
+            StartEdges.push_back(DoorEdge{ d, cost });
+    }
+    int direct = hpa_block(start_i, start_j) == hpa_block(end_i, end_j) ? block_distance(end_i, end_j) : -1;
+    EndCost.assign(door_count, -1);
+    block_search(FLR, end_i, end_j);
+    for (int d : graph.block_doors[hpa_block(end_i, end_j)])
+        EndCost[d] = block_distance(graph.doors[d].i, graph.doors[d].j);
+
+    // dijkstra, the graph is a few doors per block boundary
+    RouteCost.assign(door_count + 2, INT_MAX);
+    RoutePrevious.assign(door_count + 2, -1);
+    using Entry = std::pair<int, int>;
+    std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> open;
+    auto relax = [&](int from, int to, int cost) {
+        if (RouteCost[from] + cost < RouteCost[to]) {
+            RouteCost[to] = RouteCost[from] + cost;
+            RoutePrevious[to] = from;
+            open.push(Entry{ RouteCost[to], to });
+        }
+    };
+    RouteCost[start] = 0;
+    open.push(Entry{ 0, start });
+    while (!open.empty()) {
+        Entry top = open.top();
+        open.pop();
+        int u = top.second;
+        if (top.first > RouteCost[u])
+            continue;
+        if (u == end)
+            break;
+        if (u == start) {
+            for (DoorEdge& e : StartEdges)
+                relax(u, e.door, e.cost);
+            if (direct >= 0)
+                relax(u, end, direct);
+            continue;
+        }
+        for (DoorEdge& e : graph.doors[u].edges)
+            relax(u, e.door, e.cost);
+        if (EndCost[u] >= 0)
+            relax(u, end, EndCost[u]);
+    }
+    if (RouteCost[end] == INT_MAX)
+        return false;
+
+    route->clear();
+    for (int d = RoutePrevious[end]; d != start; d = RoutePrevious[d])
+        route->push_back(d);
+    std::reverse(route->begin(), route->end());
+    return true;
+}
+
+// tiles after a up to b, which share a block or sit either side of a boundary
+static bool refine(int ai, int aj, int bi, int bj, std::vector<int> *out)
+{
+    int distance = Node::dist(ai, aj, bi, bj);
+    if (distance == 0)
+        return true;
+    if (distance == 1) {
+        out->push_back(bi * FLR.size + bj);
+        return true;
+    }
+    int b = hpa_block(ai, aj);
+    int gi = b / FLR.graph_size;
+    int gj = b % FLR.graph_size;
+    if (!astar_solve_in(ai, aj, bi, bj, graph_to_map_lo(gi), graph_to_map_lo(gj),
+            graph_to_map_hi(gi), graph_to_map_hi(gj)))
+        return false;
+    astar_path(bi, bj, out);
+    return true;
+}
+
+static std::vector<int> Route;
+static std::vector<int> Segment;
+
+bool hpa_solve(int start_i, int start_j, int end_i, int end_j, std::vector<int> *out)
+{
+    PROF_ZONE("hpa_solve");
+    out->clear();
+    PathGraph& graph = FLR.Paths;
+    if (!hpa_route(start_i, start_j, end_i, end_j, &Route))
+        return false;
+
+    int i = start_i, j = start_j;
+    int previous_door = -1;
+    for (int d : Route) {
+        Door& door = graph.doors[d];
+        if (previous_door < 0) {
+            if (!refine(i, j, door.i, door.j, out))
+                return false;
+        }
+        else {
+            // door to door pieces are the same for every query through them
+            uint64_t key = (uint64_t)(i * FLR.size + j) << 32 | (uint32_t)(door.i * FLR.size + door.j);
+            auto cached = graph.segments.find(key);
+            if (cached == graph.segments.end()) {
+                Segment.clear();
+                if (!refine(i, j, door.i, door.j, &Segment))
+                    return false;
+                cached = graph.segments.emplace(key, Segment).first;
+            }
+            out->insert(out->end(), cached->second.begin(), cached->second.end());
+        }
+        i = door.i;
+        j = door.j;
+        previous_door = d;
+    }
+    return refine(i, j, end_i, end_j, out);
+}
+
+/**
+ * Check
+ */
+
+static std::vector<int> Checked;
+static std::vector<int> Shortest;
+
+// tiles follow on from start one step at a time over open ground and finish at end
+static bool path_valid(int start_i, int start_j, int end_i, int end_j, const std::vector<int>& path)
+{
+    int i = start_i, j = start_j;
+    for (int n : path) {
+        int ni = n / FLR.size;
+        int nj = n % FLR.size;
+        if (Node::dist(i, j, ni, nj) != 1 || !FLR.walkable(ni, nj))
+            return false;
+        i = ni;
+        j = nj;
+    }
+    return i == end_i && j == end_j;
+}
+
+static void rand_walkable(Rng& rng, int *i, int *j)
+{
+    do {
+        *i = rng.range(0, FLR.size);
+        *j = rng.range(0, FLR.size);
+    } while (!FLR.walkable(*i, *j));
+}
+
+int hpa_check(int samples, uint64_t seed)
+{
+    PROF_ZONE("hpa_check");
+    Rng rng(seed);
+    int mismatches = 0, reached = 0;
+    long extra = 0, shortest = 0;
+    double worst = 1.0;
+    for (int k = 0; k < samples; ++k) {
+        int si, sj, ei, ej;
+        rand_walkable(rng, &si, &sj);
+        rand_walkable(rng, &ei, &ej);
+
+        // both agree on whether end can be reached, and HPA* never beats the shortest
+        bool hpa = hpa_solve(si, sj, ei, ej, &Checked);
+        bool astar = astar_solve(si, sj, ei, ej);
+        Shortest.clear();
+        if (astar)
+            astar_path(ei, ej, &Shortest);
+        if (hpa != astar || (hpa && (!path_valid(si, sj, ei, ej, Checked) || Checked.size() < Shortest.size()))) {
+            fprintf(stderr, "Error: Paths disagree from (%d, %d) to (%d, %d), HPA* %d steps, A* %d steps\n",
+                si, sj, ei, ej, hpa ? (int)Checked.size() : -1, astar ? (int)Shortest.size() : -1);
+            mismatches += 1;
+            continue;
+        }
+        if (!hpa || Shortest.empty())
+            continue;
+        reached += 1;
+        extra += (long)(Checked.size() - Shortest.size());
+        shortest += (long)Shortest.size();
+        worst = std::max(worst, (double)Checked.size() / Shortest.size());
+    }
+    printf("Paths: %d of %d pairs agree with A*, %d reachable, %.2f%% longer overall, %.2fx at worst\n",
+        samples - mismatches, samples, reached, shortest > 0 ? 100.0 * extra / shortest : 0.0, worst);
+    return mismatches;
+}
+
+}
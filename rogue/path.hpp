@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+namespace Modules {
+
+/******************************************************************************
+ * Hierarchical Pathfinding
+ *
+ * https://webdocs.cs.ualberta.ca/~mmueller/ps/hpastar.pdf
+ *
+ * The map is cut into the graph_size x graph_size blocks the rooms are laid
+ * out on. Every run of open tiles across a block boundary gets a door on
+ * each side, and doors of the same block are joined by their walking
+ * distance inside it. A query joins start and end to their block's doors,
+ * searches that small graph, then refines one block at a time. Refined door
+ * to door segments are cached on the floor. The player's travel plans its
+ * whole walk with one query.
+ *
+ * One door per run keeps the graph small but isn't exact, a path can be a
+ * few steps longer than the shortest. hpa_check measures how many.
+ */
+
+struct Floor;
+
+int hpa_block(int i, int j); // block index of a tile
+void hpa_build(Floor& floor); // doors and in-block costs of a floor, on any thread
+bool hpa_solve(int start_i, int start_j, int end_i, int end_j, std::vector<int> *out); // tiles after start up to end, flat indices
+int hpa_check(int samples, uint64_t seed); // random pairs against full-grid A*, prints the summary and returns the mismatches
+
+}
@@ -10,13 +10,21 @@
  */
 
 #include "../../pse.hpp"
+#include "../prof/counters.hpp"
+#include "../prof/timing.hpp"
+#include "../prof/zones.hpp"
 #include "entity.hpp"
 #include "draw.hpp"
+#include "dungeon.hpp"
 #include "gen.hpp"
 #include "globals.hpp"
+#include "path.hpp"
 #include "types.hpp"
 
+#include <algorithm>
 #include <cstdio>
+#include <cstdlib>
+#include <cstring>
 
 namespace Modules {
 
@@ -26,10 +34,10 @@ namespace Modules {
 
 static void debug_print_map()
 {
-    for (int i = 0; i < MAP_SIZE; ++i) {
+    for (int i = 0; i < FLR.size; ++i) {
         printf("\n");
-        for (int j = 0; j < MAP_SIZE; ++j) {
-            printf("%c", (char)FLR.Map[i][j]);
+        for (int j = 0; j < FLR.size; ++j) {
+            printf("%c", (char)FLR.tile(i, j));
         }
     }
     printf("\n");
@@ -48,24 +56,79 @@ static void debug_print_player()
 void rogue_setup(pse::Context& ctx)
 {
     PSE_Context = &ctx;
-    gen_floor();
+    prof::zone_thread_name("main");
+    // floor side in tiles
+    if (const char *size = getenv("ROGUE_MAP_SIZE"))
+        FloorSize = std::max(MAP_SIZE_MIN, std::min(atoi(size), MAP_SIZE_MAX));
+    // "caves" for cellular automata floors instead of rooms
+    if (const char *generator = getenv("ROGUE_GENERATOR"))
+        FloorGenerator = strcmp(generator, "caves") == 0 ? GEN_CAVES : GEN_ROOMS;
+    // floors kept in memory, the rest wait in the save directory
+    if (const char *resident = getenv("ROGUE_RESIDENT_FLOORS"))
+        FloorsResident = std::max(FLOORS_RESIDENT_MIN, atoi(resident));
+    // enemies on each floor generated, ROGUE_ENEMIES=20000 for a crowd
+    if (const char *enemies = getenv("ROGUE_ENEMIES"))
+        EnemyCount = std::max(0, atoi(enemies));
+    if (const char *dir = getenv("ROGUE_SAVE_DIR"))
+        SaveDir = dir;
     astar_init();
+
+    // pick up the saved dungeon, unless a seed asks for a particular one
+    const char *seed = getenv("ROGUE_SEED");
+    if (seed || !dungeon_resume()) {
+        DungeonSeed = seed ? strtoull(seed, nullptr, 16) : (uint64_t)rand() << 32 ^ (uint64_t)rand();
+        printf("Dungeon seed: %016llx\n", (unsigned long long)DungeonSeed);
+        dungeon_start();
+    }
+    // check HPA* against A* on the floor we start on, refusing to start if any pair disagrees
+    if (const char *check = getenv("ROGUE_CHECK_PATHS")) {
+        if (hpa_check(std::max(1, atoi(check)), DungeonSeed) > 0) {
+            fprintf(stderr, "Error: HPA* and A* disagree\n");
+            exit(-1);
+        }
+    }
+    atexit(dungeon_save);
     load_sprites();
 }
 
 void rogue_update(pse::Context& ctx)
 {
+    PROF_MODULE("rogue");
+    PROF_ZONE("rogue_update");
     if (ctx.check_key(SDL_SCANCODE_LSHIFT))
-        gen_floor();
+        floor_regenerate();
+    // switch generators for the floors made from now on
+    if (ctx.check_key_invalidate(SDL_SCANCODE_C)) {
+        FloorGenerator = FloorGenerator == GEN_CAVES ? GEN_ROOMS : GEN_CAVES;
+        printf("Generator: %s\n", FloorGenerator == GEN_CAVES ? "caves" : "rooms");
+        floor_pregenerate(FloorLevel + 1);
+    }
 
+    // travel to the stairs down once their room has been seen
+    if (ctx.check_key_invalidate(SDL_SCANCODE_T)) {
+        if (!FLR.room(FLR.End_i, FLR.End_j).is_explored)
+            printf("No stairs down found yet...\n");
+        else if (!travel_start(FLR.StairDown.map_y, FLR.StairDown.map_x))
+            printf("No way to the stairs down...\n");
+    }
+
+    // a move of our own ends any travel
+    int direction = -1;
     if (ctx.check_key_invalidate(SDL_SCANCODE_K) || ctx.check_key_invalidate(SDL_SCANCODE_UP))
-        entity_move(UP);
+        direction = UP;
     else if (ctx.check_key_invalidate(SDL_SCANCODE_L) || ctx.check_key_invalidate(SDL_SCANCODE_RIGHT))
-        entity_move(RIGHT);
+        direction = RIGHT;
     else if (ctx.check_key_invalidate(SDL_SCANCODE_J) || ctx.check_key_invalidate(SDL_SCANCODE_DOWN))
-        entity_move(DOWN);
+        direction = DOWN;
     else if (ctx.check_key_invalidate(SDL_SCANCODE_H) || ctx.check_key_invalidate(SDL_SCANCODE_LEFT))
-        entity_move(LEFT);
+        direction = LEFT;
+    if (direction >= 0) {
+        travel_stop();
+        entity_move(direction);
+    }
+    else if (!travel_step()) {
+        travel_stop();
+    }
 
     if (coords_equal(Player.map_x, Player.map_y, FLR.StairDown.map_x, FLR.StairDown.map_y)
             && ctx.check_key_invalidate(SDL_SCANCODE_SPACE))
@@ -74,6 +137,18 @@ void rogue_update(pse::Context& ctx)
             && ctx.check_key_invalidate(SDL_SCANCODE_SPACE))
         floor_switch(UP);
 
+    // print update timings and pathfinding counters, with PSE_PERF_COUNTERS set
+    if (ctx.check_key_invalidate(SDL_SCANCODE_P)) {
+        prof::modules_report();
+        prof::counters_report();
+    }
+    // compare HPA* with full-grid A* on this floor
+    if (ctx.check_key_invalidate(SDL_SCANCODE_V))
+        hpa_check(PATH_CHECK_SAMPLES, DungeonSeed ^ (uint64_t)FloorLevel);
+    // write the last few seconds of zones for Perfetto
+    if (ctx.check_key_invalidate(SDL_SCANCODE_Z))
+        prof::zones_dump("rogue_zones.json", prof::ZONE_DUMP_SECONDS);
+
     if (ctx.check_key(SDL_SCANCODE_ESCAPE))
         ctx.quit();
 
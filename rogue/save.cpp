@@ -0,0 +1,450 @@
+#include <cstdio>
+#include <filesystem>
+
+#include "../../pse.hpp"
+#include "../prof/zones.hpp"
+#include "entity.hpp"
+#include "globals.hpp"
+#include "save.hpp"
+#include "types.hpp"
+
+namespace Modules {
+
+static const uint32_t FLOOR_MAGIC = 0x524c4652; // "RFLR"
+static const uint32_t DUNGEON_MAGIC = 0x4e474452; // "RDGN"
+static const uint32_t SAVE_VERSION = 2;
+static const uint64_t TILES_BITS = 0;
+static const uint64_t TILES_RUNS = 1;
+
+/**
+ * Varints
+ */
+
+struct Writer {
+    std::vector<uint8_t> bytes;
+
+    void varint(uint64_t v) {
+        while (v >= 0x80) {
+            this->bytes.push_back((uint8_t)(v | 0x80));
+            v >>= 7;
+        }
+        this->bytes.push_back((uint8_t)v);
+    }
+    // zigzag, small negatives stay small
+    void integer(int64_t v) {
+        this->varint((uint64_t)v << 1 ^ (uint64_t)(v >> 63));
+    }
+    void entity(const Entity& e) {
+        this->integer(e.graph_x);
+        this->integer(e.graph_y);
+        this->integer(e.map_x);
+        this->integer(e.map_y);
+        this->integer(e.id);
+    }
+};
+
+// reads past the end or a malformed varint leave ok false and read zeros
+struct Reader {
+    const uint8_t *at;
+    const uint8_t *end;
+    bool ok = true;
+
+    uint64_t varint() {
+        uint64_t v = 0;
+        for (int shift = 0; shift < 64; shift += 7) {
+            if (this->at == this->end) {
+                this->ok = false;
+                return 0;
+            }
+            uint8_t byte = *this->at++;
+            v |= (uint64_t)(byte & 0x7f) << shift;
+            if (!(byte & 0x80))
+                return v;
+        }
+        this->ok = false;
+        return 0;
+    }
+    int64_t integer() {
+        uint64_t v = this->varint();
+        return (int64_t)(v >> 1) ^ -(int64_t)(v & 1);
+    }
+    // a count of things still to come, at least a byte each
+    size_t count() {
+        uint64_t n = this->varint();
+        if (n > (uint64_t)(this->end - this->at)) {
+            this->ok = false;
+            return 0;
+        }
+        return (size_t)n;
+    }
+    Entity entity() {
+        Entity e{};
+        e.graph_x = (int)this->integer();
+        e.graph_y = (int)this->integer();
+        e.map_x = (int)this->integer();
+        e.map_y = (int)this->integer();
+        e.id = (int)this->integer();
+        return e;
+    }
+};
+
+/**
+ * Floors
+ */
+
+std::vector<uint8_t> floor_serialize(const Floor& floor)
+{
+    PROF_ZONE("floor_serialize");
+    Writer w;
+    w.varint(FLOOR_MAGIC);
+    w.varint(SAVE_VERSION);
+    w.varint(DungeonSeed);
+    w.varint(floor.seed);
+    w.integer(floor.size);
+    w.varint(floor.visited);
+    w.integer(floor.Start_i);
+    w.integer(floor.Start_j);
+    w.integer(floor.End_i);
+    w.integer(floor.End_j);
+
+    // row major runs of one tile, or the walkability bits when the floor is
+    // only rock and open tiles and that comes out smaller
+    Writer runs;
+    bool binary = true;
+    int run_tile = floor.tile(0, 0);
+    uint64_t run = 0;
+    for (int i = 0; i < floor.size; ++i) {
+        for (int j = 0; j < floor.size; ++j) {
+            int tile = floor.tile(i, j);
+            binary = binary && (tile == WALL || tile == FLOOR);
+            if (tile != run_tile) {
+                runs.varint((uint64_t)run_tile);
+                runs.varint(run);
+                run_tile = tile;
+                run = 0;
+            }
+            run += 1;
+        }
+    }
+    runs.varint((uint64_t)run_tile);
+    runs.varint(run);
+
+    size_t row_bytes = (size_t)(floor.size + 7) / 8;
+    if (binary && row_bytes * floor.size < runs.bytes.size()) {
+        w.varint(TILES_BITS);
+        for (int i = 0; i < floor.size; ++i) {
+            const uint64_t *row = floor.Walkable.row(i);
+            for (size_t b = 0; b < row_bytes; ++b)
+                w.bytes.push_back((uint8_t)(row[b >> 3] >> ((b & 7) * 8)));
+        }
+    }
+    else {
+        w.varint(TILES_RUNS);
+        w.bytes.insert(w.bytes.end(), runs.bytes.begin(), runs.bytes.end());
+    }
+
+    // graph_size follows from size
+    for (const Room& room : floor.Graph) {
+        w.varint(room.is_connected | room.is_explored << 1 | room.is_gone << 2);
+        w.integer(room.index);
+        for (int k = 0; k < room.index; ++k)
+            w.integer(room.neighbors[k]);
+        w.integer(room.map_h);
+        w.integer(room.map_w);
+        w.integer(room.map_i);
+        w.integer(room.map_j);
+        w.integer(room.center_i);
+        w.integer(room.center_j);
+        w.integer(room.open_tiles);
+    }
+
+    w.entity(floor.StairUp);
+    w.entity(floor.StairDown);
+    // rooms of pooled entities follow from where they stand
+    const EntityPool& pool = floor.Entities;
+    w.varint(pool.size());
+    for (int k = 0; k < pool.size(); ++k) {
+        w.varint(pool.id[k]);
+        w.integer(pool.map_y[k]);
+        w.integer(pool.map_x[k]);
+    }
+
+    // refined segments are a cache, only the doors are kept. Doors come in
+    // scan order and are joined to doors of the same block, so positions and
+    // edges are written as deltas, and blocks follow from positions
+    w.varint(floor.Paths.built);
+    w.varint(floor.Paths.doors.size());
+    int previous = 0;
+    for (size_t d = 0; d < floor.Paths.doors.size(); ++d) {
+        const Door& door = floor.Paths.doors[d];
+        int index = door.i * floor.size + door.j;
+        w.integer(index - previous);
+        previous = index;
+        w.varint(door.edges.size());
+        for (const DoorEdge& edge : door.edges) {
+            w.integer(edge.door - (int)d);
+            w.varint((uint64_t)edge.cost);
+        }
+    }
+    return std::move(w.bytes);
+}
+
+bool floor_deserialize(Floor& floor, const std::vector<uint8_t>& bytes)
+{
+    PROF_ZONE("floor_deserialize");
+    Reader r{ bytes.data(), bytes.data() + bytes.size() };
+    if (r.varint() != FLOOR_MAGIC || r.varint() != SAVE_VERSION || r.varint() != DungeonSeed)
+        return false;
+
+    Floor loaded;
+    uint64_t seed = r.varint();
+    int size = (int)r.integer();
+    if (!r.ok || size < MAP_SIZE_MIN || size > MAP_SIZE_MAX)
+        return false;
+    loaded.resize(size);
+    loaded.seed = seed;
+    loaded.visited = r.varint() != 0;
+    loaded.Start_i = (int)r.integer();
+    loaded.Start_j = (int)r.integer();
+    loaded.End_i = (int)r.integer();
+    loaded.End_j = (int)r.integer();
+
+    uint64_t tiles_mode = r.varint();
+    if (tiles_mode == TILES_BITS) {
+        size_t row_bytes = (size_t)(size + 7) / 8;
+        if ((size_t)(r.end - r.at) < row_bytes * size)
+            return false;
+        for (int i = 0; i < size; ++i) {
+            for (size_t b = 0; b < row_bytes; ++b) {
+                for (uint8_t byte = *r.at++; byte; byte &= byte - 1) {
+                    int j = (int)b * 8 + __builtin_ctz(byte);
+                    if (j < size)
+                        loaded.set_tile(i, j, FLOOR);
+                }
+            }
+        }
+    }
+    else if (tiles_mode == TILES_RUNS) {
+        uint64_t tiles = (uint64_t)size * size;
+        uint64_t k = 0;
+        while (r.ok && k < tiles) {
+            int tile = (int)r.varint();
+            uint64_t run = r.varint();
+            if (run == 0 || run > tiles - k) {
+                r.ok = false;
+                break;
+            }
+            // resize left every tile rock
+            if (tile == WALL) {
+                k += run;
+                continue;
+            }
+            for (; run > 0; --run, ++k)
+                loaded.set_tile((int)(k / size), (int)(k % size), tile);
+        }
+    }
+    else {
+        return false;
+    }
+
+    for (Room& room : loaded.Graph) {
+        uint64_t flags = r.varint();
+        room.is_connected = flags & 1;
+        room.is_explored = flags & 2;
+        room.is_gone = flags & 4;
+        room.index = (int)r.integer();
+        if (room.index < 0 || room.index > NEIGHBORS_MAX) {
+            r.ok = false;
+            break;
+        }
+        for (int n = 0; n < room.index; ++n)
+            room.neighbors[n] = (int)r.integer();
+        room.map_h = (int)r.integer();
+        room.map_w = (int)r.integer();
+        room.map_i = (int)r.integer();
+        room.map_j = (int)r.integer();
+        room.center_i = (int)r.integer();
+        room.center_j = (int)r.integer();
+        room.open_tiles = (int)r.integer();
+    }
+
+    // everything that indexes the map or graph is checked, a damaged file reads as missing
+    auto on_map = [&](int i, int j) { return loaded.Map.contains(i, j); };
+    auto on_graph = [&](int gi, int gj) {
+        return gi >= 0 && gi < loaded.graph_size && gj >= 0 && gj < loaded.graph_size;
+    };
+    auto placed = [&](const Entity& e) { return on_map(e.map_y, e.map_x) && on_graph(e.graph_y, e.graph_x); };
+    loaded.StairUp = r.entity();
+    loaded.StairDown = r.entity();
+    r.ok = r.ok && placed(loaded.StairUp) && placed(loaded.StairDown);
+    size_t pooled = r.count();
+    loaded.Entities.reserve((int)pooled);
+    for (size_t k = 0; k < pooled && r.ok; ++k) {
+        int id = (int)r.varint();
+        int i = (int)r.integer();
+        int j = (int)r.integer();
+        if (id != ID_ENEMY || !on_map(i, j)) {
+            r.ok = false;
+            break;
+        }
+        loaded.Entities.spawn(id, i, j, loaded.block_of(i), loaded.block_of(j));
+    }
+    r.ok = r.ok && on_graph(loaded.Start_i, loaded.Start_j) && on_graph(loaded.End_i, loaded.End_j);
+
+    PathGraph& graph = loaded.Paths;
+    graph.built = r.varint() != 0;
+    graph.doors.resize(r.count());
+    graph.block_doors.assign(loaded.Graph.size(), std::vector<int>{});
+    int index = 0;
+    for (size_t d = 0; d < graph.doors.size() && r.ok; ++d) {
+        Door& door = graph.doors[d];
+        index += (int)r.integer();
+        door.i = index / size;
+        door.j = index % size;
+        if (index < 0 || !on_map(door.i, door.j)) {
+            r.ok = false;
+            break;
+        }
+        door.block = loaded.block_of(door.i) * loaded.graph_size + loaded.block_of(door.j);
+        graph.block_doors[door.block].push_back((int)d);
+        door.edges.resize(r.count());
+        for (DoorEdge& edge : door.edges) {
+            edge.door = (int)d + (int)r.integer();
+            edge.cost = (int)r.varint();
+            r.ok = r.ok && edge.door >= 0 && edge.door < (int)graph.doors.size();
+        }
+    }
+
+    if (!r.ok)
+        return false;
+    // occupancy isn't saved, whoever stands somewhere says so again
+    occupy(loaded, loaded.StairUp.map_y, loaded.StairUp.map_x);
+    occupy(loaded, loaded.StairDown.map_y, loaded.StairDown.map_x);
+    const EntityPool& pool = loaded.Entities;
+    for (int k = 0; k < pool.size(); ++k) {
+        if (loaded.Occupancy.get(pool.map_y[k], pool.map_x[k]) == UINT8_MAX)
+            return false;
+        occupy(loaded, pool.map_y[k], pool.map_x[k]);
+    }
+    floor = std::move(loaded);
+    return true;
+}
+
+/**
+ * Files
+ */
+
+// whole file, false if it can't be read
+static bool read_file(const std::string& path, std::vector<uint8_t> *out)
+{
+    FILE *file = fopen(path.c_str(), "rb");
+    if (!file)
+        return false;
+    out->clear();
+    uint8_t buffer[1 << 16];
+    size_t n;
+    while ((n = fread(buffer, 1, sizeof(buffer), file)) > 0)
+        out->insert(out->end(), buffer, buffer + n);
+    bool ok = !ferror(file);
+    fclose(file);
+    return ok;
+}
+
+// through a temporary file, an interrupted save leaves the old file whole
+static bool write_file(const std::string& path, const std::vector<uint8_t>& bytes)
+{
+    std::error_code error;
+    std::filesystem::create_directories(SaveDir, error);
+    std::string temporary = path + ".tmp";
+    FILE *file = fopen(temporary.c_str(), "wb");
+    if (!file) {
+        fprintf(stderr, "Error: Couldn't open %s for writing\n", temporary.c_str());
+        return false;
+    }
+    bool ok = fwrite(bytes.data(), 1, bytes.size(), file) == bytes.size();
+    ok = fclose(file) == 0 && ok;
+    std::filesystem::rename(temporary, path, error);
+    if (!ok || error) {
+        fprintf(stderr, "Error: Couldn't write %s\n", path.c_str());
+        return false;
+    }
+    return true;
+}
+
+std::string floor_path(int level)
+{
+    return std::string(SaveDir) + "/floor_" + std::to_string(level) + ".bin";
+}
+
+bool floor_saved(int level)
+{
+    // only the header, to tell this dungeon's floors from stale ones
+    FILE *file = fopen(floor_path(level).c_str(), "rb");
+    if (!file)
+        return false;
+    uint8_t header[32];
+    size_t n = fread(header, 1, sizeof(header), file);
+    fclose(file);
+    Reader r{ header, header + n };
+    return r.varint() == FLOOR_MAGIC && r.varint() == SAVE_VERSION && r.varint() == DungeonSeed && r.ok;
+}
+
+bool floor_save(const Floor& floor, int level)
+{
+    PROF_ZONE("floor_save");
+    return write_file(floor_path(level), floor_serialize(floor));
+}
+
+bool floor_load(Floor& floor, int level)
+{
+    PROF_ZONE("floor_load");
+    std::vector<uint8_t> bytes;
+    if (!read_file(floor_path(level), &bytes))
+        return false;
+    if (!floor_deserialize(floor, bytes)) {
+        fprintf(stderr, "Error: %s isn't a floor of this dungeon\n", floor_path(level).c_str());
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Dungeon
+ */
+
+bool dungeon_save_state()
+{
+    Writer w;
+    w.varint(DUNGEON_MAGIC);
+    w.varint(SAVE_VERSION);
+    w.varint(DungeonSeed);
+    w.integer(FloorLevel);
+    w.integer(LastStairDirection);
+    w.integer(Player.map_y);
+    w.integer(Player.map_x);
+    return write_file(std::string(SaveDir) + "/dungeon.bin", w.bytes);
+}
+
+bool dungeon_load_state(int *player_i, int *player_j)
+{
+    std::vector<uint8_t> bytes;
+    if (!read_file(std::string(SaveDir) + "/dungeon.bin", &bytes))
+        return false;
+    Reader r{ bytes.data(), bytes.data() + bytes.size() };
+    if (r.varint() != DUNGEON_MAGIC || r.varint() != SAVE_VERSION)
+        return false;
+    uint64_t seed = r.varint();
+    int level = (int)r.integer();
+    int direction = (int)r.integer();
+    *player_i = (int)r.integer();
+    *player_j = (int)r.integer();
+    if (!r.ok || level < 0 || (direction != UP && direction != DOWN))
+        return false;
+
+    DungeonSeed = seed;
+    FloorLevel = level;
+    LastStairDirection = direction;
+    return true;
+}
+
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace Modules {
+
+/******************************************************************************
+ * Saving
+ *
+ * Floors are written as varints: tiles as the walkability bits or as runs
+ * of one MapTile, whichever is smaller, then rooms, stairs, pooled entities
+ * and the doors of the room graph, so a loaded floor needs no rebuilding.
+ * Every file starts with the dungeon seed, files left over from another
+ * dungeon read as missing.
+ */
+
+struct Floor;
+
+std::vector<uint8_t> floor_serialize(const Floor& floor);
+bool floor_deserialize(Floor& floor, const std::vector<uint8_t>& bytes); // false if bytes aren't a floor of this dungeon
+
+std::string floor_path(int level); // file of a level in SaveDir
+bool floor_saved(int level); // a file of this dungeon exists for level
+bool floor_save(const Floor& floor, int level);
+bool floor_load(Floor& floor, int level); // false and floor untouched if there's no usable file
+
+bool dungeon_save_state(); // seed, level and player, next to the floors
+bool dungeon_load_state(int *player_i, int *player_j); // false if there's no saved dungeon
+
+}
@@ -21,22 +21,6 @@ bool Room::check_neighbor(int neighbor) {
     return false;
 }
 
-// range within the room, not including outer area/walls
-void Room::rand_tile(int* i, int *j) {
-    *i = rand_range(map_i + 2, map_i + map_h - 2);
-    *j = rand_range(map_j + 2, map_j + map_w - 2);
-}
-
-void Room::rand_corridor(int *i, int *j) {
-    // pick a direction
-    switch (neighbors[rand_range(0, index)]) {
-        case UP:    *i = rand_range(center_i - map_h / 2, center_i); *j = center_j; break;
-        case RIGHT: *j = rand_range(center_j, center_j + map_h / 2); *i = center_i; break;
-        case DOWN:  *i = rand_range(center_i, center_i + map_h / 2); *j = center_j; break;
-        case LEFT:  *j = rand_range(center_j - map_h / 2, center_j); *i = center_i; break;
-    }
-}
-
 void Room::print() {
     for (int i = 0; i < index; ++i) {
         switch (neighbors[i]) {
@@ -54,12 +38,7 @@ void Room::print() {
 
 bool Entity::check_tile(int offset_x, int offset_y)
 {
-    switch (FLR.Map[map_y + offset_y][map_x + offset_x]) {
-        case FLOOR:
-            return true;
-        default:
-            return false;
-    }
+    return FLR.walkable(map_y + offset_y, map_x + offset_x);
 }
 
 void Entity::move(int direction)
@@ -3,24 +3,153 @@
 #include "../../pse.hpp"
 #include "globals.hpp"
 
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <memory>
+#include <unordered_map>
 #include <vector>
 
 namespace Modules {
 
+// A* state of one tile, only meaningful while generation is SearchGeneration
 struct Node {
-    bool obstacle = false;
-    bool visited = false;
-    float global_goal;
-    float local_goal;
-    int x, y;
-    std::vector<Node *> neighbors;
-    Node *parent;
+    uint32_t generation = 0;
+    int heap_index = 0; // position in OpenNodes, NODE_CLOSED once expanded
+    int local_goal = 0; // steps from the start
+    int global_goal = 0; // local goal plus the manhattan distance left
+    int parent = -1; // flat index (i * size + j) of the previous tile
 
-    static bool cmp(Node *a, Node *b) {
-        return a->global_goal < b->global_goal;
+    static int dist(int ai, int aj, int bi, int bj) {
+        return abs(ai - bi) + abs(aj - bj);
     }
-    static float dist(Node *a, Node *b) {
-        return fast_sqrtf((a->x - b->x) * (a->x - b->x) + (a->y - b->y) * (a->y - b->y));
+};
+
+// entry of the A* open heap, Nodes chunks never move during a search
+struct OpenNode {
+    Node *node;
+    int index; // flat tile index
+};
+
+// grid of T stored in CHUNK_SIZE square chunks, allocated the first time
+// one of their cells is written. Cells of a missing chunk read as fill, so
+// large floors only pay for the area that isn't solid rock.
+template <typename T>
+struct ChunkGrid {
+    int width = 0;
+    int height = 0;
+    int chunks_w = 0;
+    T fill{};
+    std::vector<std::unique_ptr<T[]>> chunks;
+
+    // drops every chunk
+    void resize(int width, int height, T fill) {
+        this->width = width;
+        this->height = height;
+        this->fill = fill;
+        this->chunks_w = (width + CHUNK_MASK) >> CHUNK_BITS;
+        this->chunks.clear();
+        this->chunks.resize((size_t)this->chunks_w * ((height + CHUNK_MASK) >> CHUNK_BITS));
+    }
+    // every cell back to fill
+    void clear() {
+        for (auto& chunk : this->chunks)
+            chunk.reset();
+    }
+    bool contains(int i, int j) const {
+        return i >= 0 && i < this->height && j >= 0 && j < this->width;
+    }
+    T get(int i, int j) const {
+        const T *chunk = this->chunks[(i >> CHUNK_BITS) * this->chunks_w + (j >> CHUNK_BITS)].get();
+        return chunk ? chunk[((i & CHUNK_MASK) << CHUNK_BITS) | (j & CHUNK_MASK)] : this->fill;
+    }
+    T& at(int i, int j) {
+        std::unique_ptr<T[]>& chunk = this->chunks[(i >> CHUNK_BITS) * this->chunks_w + (j >> CHUNK_BITS)];
+        if (!chunk) {
+            chunk.reset(new T[CHUNK_SIZE * CHUNK_SIZE]);
+            for (int k = 0; k < CHUNK_SIZE * CHUNK_SIZE; ++k)
+                chunk[k] = this->fill;
+        }
+        return chunk[((i & CHUNK_MASK) << CHUNK_BITS) | (j & CHUNK_MASK)];
+    }
+    void set(int i, int j, T value) {
+        if (value == this->fill && !this->chunks[(i >> CHUNK_BITS) * this->chunks_w + (j >> CHUNK_BITS)])
+            return;
+        at(i, j) = value;
+    }
+    size_t bytes() const {
+        size_t allocated = 0;
+        for (auto& chunk : this->chunks)
+            allocated += chunk ? sizeof(T) * CHUNK_SIZE * CHUNK_SIZE : 0;
+        return allocated + this->chunks.size() * sizeof(this->chunks[0]);
+    }
+};
+
+// one bit per cell, 64 to a word with bit k of a word the cell k columns
+// right of the word's first. Rows are padded to whole words, padding keeps
+// the value the grid was resized with.
+struct BitGrid {
+    int width = 0;
+    int height = 0;
+    int words = 0; // per row
+    std::vector<uint64_t> bits;
+
+    void resize(int width, int height, bool value) {
+        this->width = width;
+        this->height = height;
+        this->words = (width + 63) >> 6;
+        this->bits.assign((size_t)this->words * height, value ? ~0ull : 0);
+    }
+    bool get(int i, int j) const {
+        return (this->bits[(size_t)i * this->words + (j >> 6)] >> (j & 63)) & 1;
+    }
+    void set(int i, int j, bool value) {
+        uint64_t& word = this->bits[(size_t)i * this->words + (j >> 6)];
+        uint64_t mask = 1ull << (j & 63);
+        word = value ? word | mask : word & ~mask;
+    }
+    uint64_t *row(int i) { return &this->bits[(size_t)i * this->words]; }
+    const uint64_t *row(int i) const { return &this->bits[(size_t)i * this->words]; }
+    // bits past width in the last word of a row
+    uint64_t padding() const {
+        return this->width & 63 ? ~0ull << (this->width & 63) : 0;
+    }
+    // set cells in the inclusive rectangle
+    int count(int lo_i, int lo_j, int hi_i, int hi_j) const {
+        int total = 0;
+        for (int i = lo_i; i <= hi_i; ++i) {
+            const uint64_t *row = this->row(i);
+            for (int w = lo_j >> 6; w <= hi_j >> 6; ++w) {
+                uint64_t word = row[w];
+                if (w == lo_j >> 6)
+                    word &= ~0ull << (lo_j & 63);
+                if (w == hi_j >> 6)
+                    word &= ~0ull >> (63 - (hi_j & 63));
+                total += __builtin_popcountll(word);
+            }
+        }
+        return total;
+    }
+};
+
+// splitmix64, one per floor being generated so floors come out the same
+// from the same seed on any thread
+struct Rng {
+    uint64_t state;
+
+    explicit Rng(uint64_t seed) : state(seed) {}
+    uint64_t next() {
+        uint64_t z = (this->state += 0x9e3779b97f4a7c15ull);
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+        return z ^ (z >> 31);
+    }
+    // lo up to but not including hi, like rand_range
+    int range(int lo, int hi) {
+        return hi <= lo ? lo : lo + (int)(this->next() % (uint64_t)(hi - lo));
+    }
+    double uniform() {
+        return (double)(this->next() >> 11) * (1.0 / 9007199254740992.0);
     }
 };
 
@@ -34,13 +163,13 @@ struct Room {
     int map_h, map_w;
     int map_i, map_j;
     int center_i, center_j;
+    int open_tiles = 0; // walkable tiles in the room's block
+    bool free_listed = false; // free_tiles built, kept up to date from then on
+    std::vector<int> free_tiles; // walkable tiles of the block nobody stands on, flat indices
 
     void insert_neighbor(int neighbor);
     // check if the given neighbor is already connected to
     bool check_neighbor(int neighbor);
-    // range within the room, not including outer walls
-    void rand_tile(int* i, int *j);
-    void rand_corridor(int *i, int *j);
     void print();
 };
 
@@ -48,19 +177,162 @@ struct Entity {
     int graph_x, graph_y;
     int map_x, map_y;
     int id = -1;
-    bool is_enemy = false;
 
     bool check_tile(int offset_x, int offset_y);
     // move with bounds check
     void move(int direction);
 };
 
+// names one entity of an EntityPool, a slot and the generation it had when
+// the entity was spawned so a handle kept past despawn doesn't find whoever
+// reuses the slot
+struct EntityHandle {
+    uint32_t slot = UINT32_MAX;
+    uint32_t generation = 0;
+};
+
+// entities of a floor as one array per component, live entities packed at
+// the front in no particular order so a turn walks plain arrays. Despawning
+// moves the last entity into the hole, handles go through a slot table that
+// follows it. Storage only grows, spawning into a reserved pool allocates
+// nothing. Handles last as long as the floor stays in memory.
+struct EntityPool {
+    std::vector<int> map_y, map_x;
+    std::vector<int> graph_y, graph_x; // room
+    std::vector<uint8_t> id; // EntityId
+    std::vector<uint32_t> slot; // of each packed entity
+    std::vector<uint32_t> packed; // packed index of each slot
+    std::vector<uint32_t> generation; // of each slot, bumped on despawn
+    std::vector<uint32_t> free_slots;
+
+    int size() const { return (int)this->id.size(); }
+    void reserve(int n) {
+        this->map_y.reserve(n);
+        this->map_x.reserve(n);
+        this->graph_y.reserve(n);
+        this->graph_x.reserve(n);
+        this->id.reserve(n);
+        this->slot.reserve(n);
+        this->packed.reserve(n);
+        this->generation.reserve(n);
+        this->free_slots.reserve(n);
+    }
+    // despawns everyone, handles of the pool all go stale
+    void clear() {
+        while (this->size() > 0)
+            this->despawn(this->handle(this->size() - 1));
+    }
+    EntityHandle spawn(int id, int map_y, int map_x, int graph_y, int graph_x) {
+        uint32_t s;
+        if (!this->free_slots.empty()) {
+            s = this->free_slots.back();
+            this->free_slots.pop_back();
+        }
+        else {
+            s = (uint32_t)this->packed.size();
+            this->packed.push_back(0);
+            this->generation.push_back(0);
+        }
+        this->packed[s] = (uint32_t)this->size();
+        this->map_y.push_back(map_y);
+        this->map_x.push_back(map_x);
+        this->graph_y.push_back(graph_y);
+        this->graph_x.push_back(graph_x);
+        this->id.push_back((uint8_t)id);
+        this->slot.push_back(s);
+        return EntityHandle{ s, this->generation[s] };
+    }
+    void despawn(EntityHandle h) {
+        int k = this->index(h);
+        if (k < 0)
+            return;
+        int last = this->size() - 1;
+        this->map_y[k] = this->map_y[last];
+        this->map_x[k] = this->map_x[last];
+        this->graph_y[k] = this->graph_y[last];
+        this->graph_x[k] = this->graph_x[last];
+        this->id[k] = this->id[last];
+        this->slot[k] = this->slot[last];
+        this->packed[this->slot[k]] = (uint32_t)k;
+        this->map_y.pop_back();
+        this->map_x.pop_back();
+        this->graph_y.pop_back();
+        this->graph_x.pop_back();
+        this->id.pop_back();
+        this->slot.pop_back();
+        this->generation[h.slot]++;
+        this->free_slots.push_back(h.slot);
+    }
+    // packed index of the entity, -1 once it's despawned
+    int index(EntityHandle h) const {
+        if (h.slot >= this->generation.size() || this->generation[h.slot] != h.generation)
+            return -1;
+        return (int)this->packed[h.slot];
+    }
+    EntityHandle handle(int k) const { return EntityHandle{ this->slot[k], this->generation[this->slot[k]] }; }
+};
+
+struct DoorEdge {
+    int door;
+    int cost; // steps
+};
+
+// crossing between two neighboring blocks, one Door on each side
+struct Door {
+    int i, j;
+    int block; // block_i * graph_size + block_j
+    std::vector<DoorEdge> edges;
+};
+
+// room level graph for hierarchical pathfinding, built with the floor
+struct PathGraph {
+    bool built = false;
+    std::vector<Door> doors;
+    std::vector<std::vector<int>> block_doors;
+    std::unordered_map<uint64_t, std::vector<int>> segments; // refined door to door tiles, flat indices
+};
+
 struct Floor {
-    Room Graph[GRAPH_SIZE][GRAPH_SIZE]; // graph nodes to generate a map from
-    int Map[MAP_SIZE][MAP_SIZE]; // floor plan of every tile on that floor
+    int size = 0; // side in tiles
+    int graph_size = 0; // side in rooms
+    std::vector<Room> Graph; // graph nodes to generate a map from, row major
+    ChunkGrid<uint8_t> Map; // floor plan of every tile on that floor, a MapTile each
+    BitGrid Walkable; // FLOOR tiles of Map, kept in step by set_tile
     int Start_i, Start_j, End_i, End_j; // graph locations of starting (spawn) and ending (stair) rooms
-    bool visited = false;
+    bool visited = false; // generated, stairs and enemies placed
+    uint64_t seed = 0; // generates this floor again
     Entity StairUp, StairDown;
+    EntityPool Entities; // enemies, the stairs and player aside
+    ChunkGrid<uint8_t> Occupancy; // stairs and entities standing on each tile, see occupy
+    ChunkGrid<int> FreeSlot; // position of a tile in its room's free_tiles, -1 if it isn't listed
+    PathGraph Paths;
+
+    // all rock and unconnected rooms, stairs placed again on the next spawn
+    void resize(int size) {
+        this->size = size;
+        this->visited = false;
+        this->graph_size = std::max(1, (size - 2) / ROOM_WIDTH);
+        this->Graph.assign((size_t)this->graph_size * this->graph_size, Room{});
+        this->Entities.clear();
+        this->Occupancy.resize(size, size, 0);
+        this->FreeSlot.resize(size, size, -1);
+        this->fill_rock();
+    }
+    void fill_rock() {
+        this->Map.resize(this->size, this->size, WALL);
+        this->Walkable.resize(this->size, this->size, false);
+    }
+    Room& room(int gi, int gj) { return this->Graph[gi * this->graph_size + gj]; }
+    // room blocks, the last row and column also take the tiles left over past graph_size * ROOM_WIDTH
+    int block_of(int index) const { return std::min(index / ROOM_WIDTH, this->graph_size - 1); }
+    int block_lo(int g) const { return g * ROOM_WIDTH; }
+    int block_hi(int g) const { return g == this->graph_size - 1 ? this->size - 1 : g * ROOM_WIDTH + ROOM_WIDTH - 1; }
+    int tile(int i, int j) const { return this->Map.get(i, j); }
+    bool walkable(int i, int j) const { return this->Walkable.get(i, j); }
+    void set_tile(int i, int j, int tile) {
+        this->Map.set(i, j, (uint8_t)tile);
+        this->Walkable.set(i, j, tile == FLOOR);
+    }
 };
 
 }
\ No newline at end of file
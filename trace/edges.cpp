@@ -0,0 +1,44 @@
+#include <unordered_map>
+
+#include "edges.hpp"
+
+namespace trace {
+
+void EdgeList::build(Mesh& mesh)
+{
+    this->v0.clear();
+    this->v1.clear();
+    this->f0.clear();
+    this->f1.clear();
+
+    // (low vertex, high vertex) -> edge
+    std::unordered_map<uint64_t, uint32_t> seen;
+    seen.reserve(mesh.indices.size());
+
+    for (size_t face = 0; face < mesh.indices.size() / 3; face++) {
+        for (int k = 0; k < 3; k++) {
+            uint32_t a = mesh.indices[face * 3 + k];
+            uint32_t b = mesh.indices[face * 3 + (k + 1) % 3];
+            uint64_t key = a < b ? ((uint64_t)a << 32 | b) : ((uint64_t)b << 32 | a);
+
+            auto found = seen.find(key);
+            if (found != seen.end() && this->f1[found->second] == NO_FACE) {
+                this->f1[found->second] = (uint32_t)face;
+                continue;
+            }
+
+            // new edge, or a third face on a non-manifold one which gets its own copy
+            uint32_t edge = (uint32_t)this->v0.size();
+            this->v0.push_back(a);
+            this->v1.push_back(b);
+            this->f0.push_back((uint32_t)face);
+            this->f1.push_back(NO_FACE);
+            if (found == seen.end())
+                seen[key] = edge;
+            else
+                found->second = edge;
+        }
+    }
+}
+
+} // trace
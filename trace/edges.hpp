@@ -0,0 +1,21 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "types.hpp"
+
+namespace trace {
+
+constexpr uint32_t NO_FACE = UINT32_MAX;
+
+// every edge of an indexed mesh once, with the faces on either side of it,
+// an edge is drawn when at least one of its faces is facing the camera
+struct EdgeList {
+    std::vector<uint32_t> v0, v1; // mesh vertex indices
+    std::vector<uint32_t> f0, f1; // mesh faces, f1 is NO_FACE on open edges
+
+    void build(Mesh& mesh);
+};
+
+} // trace
@@ -0,0 +1,226 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+#include "../prof/zones.hpp"
+#include "framebuffer.hpp"
+
+namespace trace {
+
+Framebuffer::~Framebuffer()
+{
+    if (this->texture)
+        SDL_DestroyTexture(this->texture);
+}
+
+void Framebuffer::resize(int width, int height)
+{
+    this->width = width;
+    this->height = height;
+    size_t size = (size_t)width * height;
+    if (this->buffers[this->back].size() != size)
+        this->buffers[this->back].assign(size, 0);
+    if (this->depth.size() != size)
+        this->depth.assign(size, INFINITY);
+}
+
+void Framebuffer::clear(uint32_t color)
+{
+    std::fill(this->buffers[this->back].begin(), this->buffers[this->back].end(), color);
+    if (this->use_depth)
+        std::fill(this->depth.begin(), this->depth.end(), INFINITY);
+}
+
+void Framebuffer::swap()
+{
+    this->front_width = this->width;
+    this->front_height = this->height;
+    this->back ^= 1;
+    this->fresh = true;
+}
+
+void Framebuffer::present()
+{
+    PROF_ZONE("present");
+    if (this->fresh) {
+        if (this->texture && (this->texture_width != this->front_width || this->texture_height != this->front_height)) {
+            SDL_DestroyTexture(this->texture);
+            this->texture = nullptr;
+            this->uploaded = false;
+        }
+        if (!this->texture) {
+            this->texture = SDL_CreateTexture(Ctx->renderer, SDL_PIXELFORMAT_ARGB8888,
+                SDL_TEXTUREACCESS_STREAMING, this->front_width, this->front_height);
+            if (!this->texture) {
+                fprintf(stderr, "Error: Could not create framebuffer texture: %s\n", SDL_GetError());
+                return;
+            }
+            this->texture_width = this->front_width;
+            this->texture_height = this->front_height;
+        }
+        SDL_UpdateTexture(this->texture, nullptr, this->buffers[this->back ^ 1].data(), this->front_width * (int)sizeof(uint32_t));
+        this->fresh = false;
+        this->uploaded = true;
+    }
+    if (this->uploaded)
+        SDL_RenderCopy(Ctx->renderer, this->texture, nullptr, nullptr);
+}
+
+void Framebuffer::present_again()
+{
+    PROF_ZONE("present");
+    if (this->uploaded)
+        SDL_RenderCopy(Ctx->renderer, this->texture, nullptr, nullptr);
+}
+
+void LineBatch::clear()
+{
+    x0.clear();
+    y0.clear();
+    x1.clear();
+    y1.clear();
+    color.clear();
+}
+
+void LineBatch::push(float x0, float y0, float x1, float y1, uint32_t color)
+{
+    this->x0.push_back(x0);
+    this->y0.push_back(y0);
+    this->x1.push_back(x1);
+    this->y1.push_back(y1);
+    this->color.push_back(color);
+}
+
+uint32_t pack_color(SDL_Color c)
+{
+    return ((uint32_t)c.a << 24) | ((uint32_t)c.r << 16) | ((uint32_t)c.g << 8) | (uint32_t)c.b;
+}
+
+void draw_lines(Framebuffer& fb, LineBatch& lines)
+{
+    float xmax = (float)fb.width - 1;
+    float ymax = (float)fb.height - 1;
+    size_t n = lines.size();
+
+    alignas(32) int32_t fx[LINE_BATCH], fy[LINE_BATCH];
+    alignas(32) int32_t ix[LINE_BATCH], iy[LINE_BATCH];
+    alignas(32) int32_t steps[LINE_BATCH];
+
+    for (size_t base = 0; base < n; base += LINE_BATCH) {
+        int count = (int)std::min((size_t)LINE_BATCH, n - base);
+        float *x0 = &lines.x0[base];
+        float *y0 = &lines.y0[base];
+        float *x1 = &lines.x1[base];
+        float *y1 = &lines.y1[base];
+
+        // Liang-Barsky against the screen and DDA setup, written as selects so it vectorizes
+        for (int i = 0; i < count; i++) {
+            float dx = x1[i] - x0[i];
+            float dy = y1[i] - y0[i];
+            float t0 = 0.0f;
+            float t1 = 1.0f;
+            bool reject = false;
+
+            float p[4] = { -dx, dx, -dy, dy };
+            float q[4] = { x0[i], xmax - x0[i], y0[i], ymax - y0[i] };
+            for (int k = 0; k < 4; k++) {
+                float r = q[k] / (p[k] != 0.0f ? p[k] : 1.0f);
+                reject = reject || (p[k] == 0.0f && q[k] < 0.0f);
+                t0 = (p[k] < 0.0f) ? std::max(t0, r) : t0;
+                t1 = (p[k] > 0.0f) ? std::min(t1, r) : t1;
+            }
+            reject = reject || t0 > t1;
+
+            float sx = x0[i] + t0 * dx;
+            float sy = y0[i] + t0 * dy;
+            float ex = x0[i] + t1 * dx;
+            float ey = y0[i] + t1 * dy;
+            float len = std::max(std::abs(ex - sx), std::abs(ey - sy));
+            int32_t s = (int32_t)std::ceil(len);
+            float inv = s > 0 ? 1.0f / (float)s : 0.0f;
+
+            // 16.16 fixed point, centered on the pixel
+            fx[i] = (int32_t)((sx + 0.5f) * 65536.0f);
+            fy[i] = (int32_t)((sy + 0.5f) * 65536.0f);
+            ix[i] = (int32_t)((ex - sx) * inv * 65536.0f);
+            iy[i] = (int32_t)((ey - sy) * inv * 65536.0f);
+            steps[i] = reject ? -1 : s;
+        }
+
+        uint32_t *pixels = fb.pixels();
+        for (int i = 0; i < count; i++) {
+            uint32_t color = lines.color[base + i];
+            int32_t x = fx[i];
+            int32_t y = fy[i];
+            for (int32_t k = 0; k <= steps[i]; k++) {
+                int px = std::min(std::max(x >> 16, 0), fb.width - 1);
+                int py = std::min(std::max(y >> 16, 0), fb.height - 1);
+                pixels[(size_t)py * fb.width + px] = color;
+                x += ix[i];
+                y += iy[i];
+            }
+        }
+    }
+}
+
+void fill_triangle(Framebuffer& fb, Triangle& t, uint32_t color)
+{
+    double ax = t.p[0].x, ay = t.p[0].y;
+    double bx = t.p[1].x, by = t.p[1].y;
+    double cx = t.p[2].x, cy = t.p[2].y;
+
+    double area = (bx - ax) * (cy - ay) - (by - ay) * (cx - ax);
+    if (area == 0.0)
+        return;
+    // either winding is accepted, flip the edges so inside is positive
+    double sign = area > 0 ? 1.0 : -1.0;
+    double inv_area = 1.0 / (area * sign);
+
+    int x0 = std::max(0, (int)std::floor(std::min({ ax, bx, cx })));
+    int y0 = std::max(0, (int)std::floor(std::min({ ay, by, cy })));
+    int x1 = std::min(fb.width - 1, (int)std::ceil(std::max({ ax, bx, cx })));
+    int y1 = std::min(fb.height - 1, (int)std::ceil(std::max({ ay, by, cy })));
+    if (x0 > x1 || y0 > y1)
+        return;
+
+    // edge functions at the first pixel center and their steps in x and y
+    double px = x0 + 0.5;
+    double py = y0 + 0.5;
+    double e0 = sign * ((cx - bx) * (py - by) - (cy - by) * (px - bx));
+    double e1 = sign * ((ax - cx) * (py - cy) - (ay - cy) * (px - cx));
+    double e2 = sign * ((bx - ax) * (py - ay) - (by - ay) * (px - ax));
+    double e0_dx = -sign * (cy - by), e0_dy = sign * (cx - bx);
+    double e1_dx = -sign * (ay - cy), e1_dy = sign * (ax - cx);
+    double e2_dx = -sign * (by - ay), e2_dy = sign * (bx - ax);
+
+    // z / w is affine in screen space so it interpolates with the edge weights
+    double az = t.p[0].z, bz = t.p[1].z, cz = t.p[2].z;
+
+    uint32_t *pixels = fb.pixels();
+    for (int y = y0; y <= y1; y++) {
+        double w0 = e0, w1 = e1, w2 = e2;
+        size_t row = (size_t)y * fb.width;
+        for (int x = x0; x <= x1; x++) {
+            if (w0 >= 0 && w1 >= 0 && w2 >= 0) {
+                if (fb.use_depth) {
+                    float z = (float)((w0 * az + w1 * bz + w2 * cz) * inv_area);
+                    if (z < fb.depth[row + x]) {
+                        fb.depth[row + x] = z;
+                        pixels[row + x] = color;
+                    }
+                }
+                else {
+                    pixels[row + x] = color;
+                }
+            }
+            w0 += e0_dx;
+            w1 += e1_dx;
+            w2 += e2_dx;
+        }
+        e0 += e0_dy;
+        e1 += e1_dy;
+        e2 += e2_dy;
+    }
+}
+
+} // trace
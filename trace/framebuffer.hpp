@@ -0,0 +1,72 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "types.hpp"
+
+namespace trace {
+
+/******************************************************************************
+ * Framebuffer
+ *
+ * CPU side ARGB pixels, and optionally depth, the trace module draws into
+ * itself. Each frame is uploaded to one streaming texture and copied to the
+ * screen in one call, instead of a backend call per triangle.
+ *
+ * There are two pixel buffers. Drawing goes to the back one while the front
+ * one holds the last finished frame, so the render thread can upload frame N
+ * while a worker draws frame N + 1. swap() hands the back buffer over once
+ * it's finished; only the render thread calls it, and only while nothing is
+ * drawing. Depth is shared since one frame is drawn at a time.
+ */
+
+struct Framebuffer {
+    int width = 0;          // of the back buffer, what draws go to
+    int height = 0;
+    std::vector<uint32_t> buffers[2];
+    int back = 0;           // buffers[back] is drawn into, the other is the front
+    int front_width = 0;
+    int front_height = 0;
+    std::vector<float> depth;
+    SDL_Texture *texture = nullptr;
+    int texture_width = 0;
+    int texture_height = 0;
+    bool use_depth = false;
+    bool fresh = false;    // the front buffer wasn't uploaded yet
+    bool uploaded = false; // texture holds a frame
+
+    ~Framebuffer();
+    // size the back buffer, the front keeps its frame
+    void resize(int width, int height);
+    uint32_t *pixels() { return buffers[back].data(); }
+    // clear the back buffer's pixels, and depth if it's in use
+    void clear(uint32_t color);
+    // the finished back buffer becomes the front, drawing moves to the other one
+    void swap();
+    // upload the front buffer if it's new and copy it to the screen
+    void present();
+    // copy the last presented frame to the screen again
+    void present_again();
+    // a frame was presented, present_again has something to show
+    bool presented() const { return this->uploaded; }
+};
+
+// lines for draw_lines in SoA layout, screen space
+struct LineBatch {
+    std::vector<float> x0, y0, x1, y1;
+    std::vector<uint32_t> color;
+
+    void clear();
+    void push(float x0, float y0, float x1, float y1, uint32_t color);
+    size_t size() { return color.size(); }
+};
+
+uint32_t pack_color(SDL_Color c);
+
+// clip and step LINE_BATCH lines at a time, setup runs over plain arrays so it vectorizes
+void draw_lines(Framebuffer& fb, LineBatch& lines);
+// fill a screen space triangle, depth tested against p[].z when the framebuffer has depth
+void fill_triangle(Framebuffer& fb, Triangle& t, uint32_t color);
+
+} // trace
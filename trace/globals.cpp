@@ -0,0 +1,8 @@
+#include "../../pse.hpp"
+#include "globals.hpp"
+
+namespace trace {
+
+pse::Context *Ctx;
+
+} // trace
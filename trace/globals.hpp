@@ -0,0 +1,34 @@
+#pragma once
+
+namespace trace {
+
+constexpr int CLUSTER_SIZE = 64;      // triangles per mesh cluster
+constexpr double LOD_KEEP = 0.5;      // share of a cluster's triangles its coarse level aims to keep
+constexpr int HIZ_SCALE = 4;          // screen pixels per texel of the base hi-z level
+constexpr int VERTEX_CACHE_SIZE = 32; // simulated post-transform cache for reordering
+constexpr int VERTEX_CACHE_SMALL = 16; // smaller FIFO the ACMR report also measures
+constexpr double WELD_EPSILON = 1e-5; // vertex weld distance relative to the mesh size
+constexpr int LINE_BATCH = 64;        // lines set up together by draw_lines
+constexpr int SUBPIXEL_BITS = 4;      // projected vertices snap to 1 / 16 of a pixel
+// frame time governor, thresholds are fractions of the target
+constexpr double GOVERNOR_HIGH = 1.1;        // lower quality above this
+constexpr double GOVERNOR_LOW = 0.7;         // raise quality below this
+constexpr double GOVERNOR_SMOOTHING = 0.1;   // weight of the newest frame in the average
+constexpr int GOVERNOR_COOLDOWN = 20;        // frames between changes
+constexpr double GOVERNOR_SCALE_STEP = 0.1;
+constexpr double GOVERNOR_MIN_SCALE = 0.5;
+constexpr double GOVERNOR_LOD_STEP = 1.0;    // pixels
+constexpr double GOVERNOR_MAX_LOD = 4.0;
+// temporal reuse of the last full frame's visible triangles
+constexpr double TEMPORAL_MOVE = 0.25; // camera travel before a full pass
+constexpr double TEMPORAL_TURN = 0.02; // yaw change before a full pass
+constexpr int TEMPORAL_MAX_AGE = 8;    // frames a visible set is reused at most
+// math_check and math_bench
+constexpr double MATH_TOLERANCE = 1e-5;   // error relative to the summed magnitude
+constexpr int MATH_CHECK_SAMPLES = 1000;
+constexpr int MATH_BENCH_VERTICES = 100000;
+constexpr int MATH_BENCH_ROUNDS = 7;
+
+extern pse::Context *Ctx;
+
+} // trace
@@ -0,0 +1,47 @@
+#include <algorithm>
+
+#include "governor.hpp"
+
+namespace trace {
+
+void Governor::update(double frame_ms)
+{
+    if (this->average_ms == 0.0)
+        this->average_ms = frame_ms;
+    else
+        this->average_ms += GOVERNOR_SMOOTHING * (frame_ms - this->average_ms);
+
+    if (this->cooldown > 0) {
+        this->cooldown -= 1;
+        return;
+    }
+
+    if (this->average_ms > this->target_ms * GOVERNOR_HIGH) {
+        if (this->lod_error < GOVERNOR_MAX_LOD)
+            this->lod_error = std::min(GOVERNOR_MAX_LOD, this->lod_error + GOVERNOR_LOD_STEP);
+        else if (this->scale > GOVERNOR_MIN_SCALE)
+            this->scale = std::max(GOVERNOR_MIN_SCALE, this->scale - GOVERNOR_SCALE_STEP);
+        else
+            return;
+        this->cooldown = GOVERNOR_COOLDOWN;
+    }
+    else if (this->average_ms < this->target_ms * GOVERNOR_LOW) {
+        if (this->scale < 1.0)
+            this->scale = std::min(1.0, this->scale + GOVERNOR_SCALE_STEP);
+        else if (this->lod_error > 0.0)
+            this->lod_error = std::max(0.0, this->lod_error - GOVERNOR_LOD_STEP);
+        else
+            return;
+        this->cooldown = GOVERNOR_COOLDOWN;
+    }
+}
+
+void Governor::reset()
+{
+    this->scale = 1.0;
+    this->lod_error = 0.0;
+    this->average_ms = 0.0;
+    this->cooldown = 0;
+}
+
+} // trace
@@ -0,0 +1,31 @@
+#pragma once
+
+#include "types.hpp"
+
+namespace trace {
+
+/******************************************************************************
+ * Frame Time Governor
+ *
+ * Trades image quality for frame time. Each frame's stage timings go in and a
+ * render resolution scale and a level of detail threshold come out: over
+ * budget the LOD threshold is raised first and the resolution lowered once it
+ * is maxed out, under budget the same steps are undone in reverse. Changes
+ * only happen outside a dead band around the target and are followed by a
+ * cooldown so the smoothed timing can settle before the next one.
+ */
+
+struct Governor {
+    double target_ms = 8.0;
+    double scale = 1.0;       // render resolution relative to the screen
+    double lod_error = 0.0;   // pixels a cluster's coarse level may be off by to be drawn instead
+    double average_ms = 0.0;  // smoothed frame time the decisions are made on
+    int cooldown = 0;         // frames left before the next change
+
+    // feed in this frame's time, may change scale and lod_error
+    void update(double frame_ms);
+    // back to full resolution and detail
+    void reset();
+};
+
+} // trace
@@ -0,0 +1,144 @@
+#include <algorithm>
+#include <cmath>
+
+#include "hiz.hpp"
+
+namespace trace {
+
+void HiZ::resize(int screen_width, int screen_height)
+{
+    int w = std::max(1, screen_width / HIZ_SCALE);
+    int h = std::max(1, screen_height / HIZ_SCALE);
+
+    this->levels.clear();
+    this->widths.clear();
+    this->heights.clear();
+    for (;;) {
+        this->levels.push_back(std::vector<float>((size_t)w * h, INFINITY));
+        this->widths.push_back(w);
+        this->heights.push_back(h);
+        if (w == 1 && h == 1)
+            break;
+        w = (w + 1) / 2;
+        h = (h + 1) / 2;
+    }
+}
+
+void HiZ::clear()
+{
+    std::fill(this->levels[0].begin(), this->levels[0].end(), INFINITY);
+}
+
+void HiZ::rasterize(Triangle& t)
+{
+    int w = this->widths[0];
+    int h = this->heights[0];
+    std::vector<float>& depth = this->levels[0];
+
+    double ax = t.p[0].x / HIZ_SCALE, ay = t.p[0].y / HIZ_SCALE;
+    double bx = t.p[1].x / HIZ_SCALE, by = t.p[1].y / HIZ_SCALE;
+    double cx = t.p[2].x / HIZ_SCALE, cy = t.p[2].y / HIZ_SCALE;
+
+    // either winding is accepted, flip the edges so inside is positive
+    double area = (bx - ax) * (cy - ay) - (by - ay) * (cx - ax);
+    if (area == 0.0)
+        return;
+    double sign = area > 0 ? 1.0 : -1.0;
+
+    // the furthest vertex stands in for the whole triangle, which keeps it conservative
+    float z = (float)std::max({ t.p[0].z, t.p[1].z, t.p[2].z });
+
+    // texels entirely inside the bounding box
+    int x0 = std::max(0, (int)std::ceil(std::min({ ax, bx, cx })));
+    int y0 = std::max(0, (int)std::ceil(std::min({ ay, by, cy })));
+    int x1 = std::min(w, (int)std::floor(std::max({ ax, bx, cx })));
+    int y1 = std::min(h, (int)std::floor(std::max({ ay, by, cy })));
+    if (x0 >= x1 || y0 >= y1)
+        return;
+
+    auto inside = [&](double x, double y) {
+        return sign * ((bx - ax) * (y - ay) - (by - ay) * (x - ax)) >= 0
+            && sign * ((cx - bx) * (y - by) - (cy - by) * (x - bx)) >= 0
+            && sign * ((ax - cx) * (y - cy) - (ay - cy) * (x - cx)) >= 0;
+    };
+
+    // a texel is covered when all four of its corners are inside, corners are
+    // shared between neighbors so classify one row of them at a time
+    static std::vector<char> above, below;
+    above.resize(x1 - x0 + 1);
+    below.resize(x1 - x0 + 1);
+    for (int x = x0; x <= x1; x++)
+        above[x - x0] = inside(x, y0);
+
+    for (int y = y0; y < y1; y++) {
+        for (int x = x0; x <= x1; x++)
+            below[x - x0] = inside(x, y + 1);
+        for (int x = x0; x < x1; x++) {
+            if (above[x - x0] && above[x - x0 + 1] && below[x - x0] && below[x - x0 + 1]) {
+                float& d = depth[(size_t)y * w + x];
+                d = std::min(d, z);
+            }
+        }
+        std::swap(above, below);
+    }
+}
+
+void HiZ::build()
+{
+    for (size_t l = 1; l < this->levels.size(); l++) {
+        std::vector<float>& src = this->levels[l - 1];
+        std::vector<float>& dst = this->levels[l];
+        int sw = this->widths[l - 1];
+        int sh = this->heights[l - 1];
+        int dw = this->widths[l];
+        int dh = this->heights[l];
+
+        for (int y = 0; y < dh; y++) {
+            int sy0 = y * 2;
+            int sy1 = std::min(sy0 + 1, sh - 1);
+            for (int x = 0; x < dw; x++) {
+                int sx0 = x * 2;
+                int sx1 = std::min(sx0 + 1, sw - 1);
+                dst[(size_t)y * dw + x] = std::max({
+                    src[(size_t)sy0 * sw + sx0], src[(size_t)sy0 * sw + sx1],
+                    src[(size_t)sy1 * sw + sx0], src[(size_t)sy1 * sw + sx1],
+                });
+            }
+        }
+    }
+}
+
+bool HiZ::occluded(double x0, double y0, double x1, double y1, double zmin)
+{
+    int w = this->widths[0];
+    int h = this->heights[0];
+
+    // bounds entirely off screen are left to the screen clipper
+    if (x1 < 0 || y1 < 0 || x0 >= w * HIZ_SCALE || y0 >= h * HIZ_SCALE)
+        return false;
+
+    int tx0 = std::clamp((int)(x0 / HIZ_SCALE), 0, w - 1);
+    int ty0 = std::clamp((int)(y0 / HIZ_SCALE), 0, h - 1);
+    int tx1 = std::clamp((int)(x1 / HIZ_SCALE), 0, w - 1);
+    int ty1 = std::clamp((int)(y1 / HIZ_SCALE), 0, h - 1);
+
+    // pick the level where the bounds touch at most 2x2 texels
+    size_t l = 0;
+    while ((tx1 - tx0 > 1 || ty1 - ty0 > 1) && l + 1 < this->levels.size()) {
+        tx0 >>= 1; ty0 >>= 1;
+        tx1 >>= 1; ty1 >>= 1;
+        l++;
+    }
+
+    std::vector<float>& depth = this->levels[l];
+    int lw = this->widths[l];
+    for (int y = ty0; y <= ty1; y++) {
+        for (int x = tx0; x <= tx1; x++) {
+            if (zmin <= depth[(size_t)y * lw + x])
+                return false;
+        }
+    }
+    return true;
+}
+
+} // trace
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <vector>
+
+#include "types.hpp"
+
+namespace trace {
+
+/******************************************************************************
+ * Hierarchical Z
+ *
+ * A max-depth pyramid of the occluders drawn so far this frame. Each texel of
+ * level n holds the furthest depth of the 2x2 texels below it, so a cluster
+ * whose nearest depth is behind every texel its screen bounds touch is hidden.
+ */
+
+struct HiZ {
+    std::vector<std::vector<float>> levels; // level 0 is 1 / HIZ_SCALE of the screen
+    std::vector<int> widths;
+    std::vector<int> heights;
+
+    void resize(int screen_width, int screen_height);
+    void clear();
+    // write a screen space triangle, only into texels it covers entirely
+    void rasterize(Triangle& t);
+    // downsample level 0 into the rest of the pyramid
+    void build();
+    // true if screen bounds x0,y0 -> x1,y1 with nearest depth zmin are behind the occluders
+    bool occluded(double x0, double y0, double x1, double y1, double zmin);
+};
+
+} // trace
@@ -0,0 +1,145 @@
+#include <cstdio>
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <vector>
+
+#include "types.hpp"
+
+namespace trace {
+
+/******************************************************************************
+ * Math Check
+ *
+ * The static_asserts in math.hpp pin the product order on integers, these run
+ * what the renderer uses: the SSE products on floats against the scalar
+ * operator*, and the fused MVP against the three double Matrix transforms
+ * each vertex took before it.
+ */
+
+// |a - b| within MATH_TOLERANCE of the magnitude the value was summed from
+static bool close(double a, double b, double magnitude)
+{
+    return std::abs(a - b) <= MATH_TOLERANCE * std::max(1.0, magnitude);
+}
+
+static bool close(const Vec4<float>& a, const Vec4<double>& b, double magnitude)
+{
+    return close(a.x, b.x, magnitude) && close(a.y, b.y, magnitude)
+        && close(a.z, b.z, magnitude) && close(a.w, b.w, magnitude);
+}
+
+// a camera somewhere around the mesh looking along yaw, like matrices() builds
+static void random_camera(std::mt19937& rng, Matrix *world_matrix, Matrix *view_matrix)
+{
+    std::uniform_real_distribution<double> position(-10.0, 10.0);
+    std::uniform_real_distribution<double> angle(-M_PI, M_PI);
+    Matrix rotz_matrix = Matrix::rotate_z(angle(rng));
+    Matrix rotx_matrix = Matrix::rotate_x(angle(rng));
+    Matrix trans_matrix = Matrix::translate(position(rng), position(rng), position(rng));
+    *world_matrix = Matrix::matmul(rotz_matrix, rotx_matrix);
+    *world_matrix = Matrix::matmul(*world_matrix, trans_matrix);
+
+    Vec camera = Vec{ position(rng), position(rng), position(rng) };
+    Vec up_vec = Vec{ 0.0, -1.0, 0.0 };
+    Vec target_vec = Vec{ 0, 0, 1 };
+    Matrix rotcamera_matrix = Matrix::rotate_y(angle(rng));
+    Vec look_dir = Vec::matmul(target_vec, rotcamera_matrix);
+    target_vec = Vec::add(camera, look_dir);
+    Matrix camera_matrix = Matrix::point_at(camera, target_vec, up_vec);
+    *view_matrix = Matrix::quick_inverse(camera_matrix);
+}
+
+int math_check(int samples, unsigned seed)
+{
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<float> value(-100.0f, 100.0f);
+    Matrix proj_matrix = Matrix::project(90.0, 0.75, 0.1, 1000.0);
+    int mismatches = 0;
+    double worst = 0.0;
+    for (int k = 0; k < samples; ++k) {
+        Vec4<float> v = Vec4<float>{ value(rng), value(rng), value(rng), value(rng) };
+        Mat4<float> a, b;
+        for (int i = 0; i < 4; i++) {
+            for (int j = 0; j < 4; j++) {
+                a.m[i][j] = value(rng);
+                b.m[i][j] = value(rng);
+            }
+        }
+
+        // vector and matrix products against the scalar ones done in double
+        Vec4<double> vd = Vec4<double>{ v.x, v.y, v.z, v.w };
+        Mat4<double> ad = mat4_cast<double>(a);
+        Mat4<double> bd = mat4_cast<double>(b);
+        double magnitude = 4 * 100.0 * 100.0;
+        bool agree = close(mul(v, a), vd * ad, magnitude);
+        Mat4<float> ab = mul(a, b);
+        Mat4<double> abd = ad * bd;
+        for (int i = 0; i < 4; i++)
+            agree = agree && close(ab.row(i), abd.row(i), magnitude);
+
+        // one fused float transform against world, view and projection one after another
+        Matrix world_matrix, view_matrix;
+        random_camera(rng, &world_matrix, &view_matrix);
+        Mat4<float> world_view = mul(to_mat4<float>(world_matrix), to_mat4<float>(view_matrix));
+        Mat4<float> mvp = mul(world_view, to_mat4<float>(proj_matrix));
+        Vec p = Vec{ v.x / 10.0f, v.y / 10.0f, v.z / 10.0f };
+        Vec transformed = Vec::matmul(p, world_matrix);
+        Vec viewed = Vec::matmul(transformed, view_matrix);
+        Vec projected = Vec::matmul(viewed, proj_matrix);
+        Vec4<float> fused = mul(Vec4<float>{ (float)p.x, (float)p.y, (float)p.z }, mvp);
+        Vec4<double> separate = Vec4<double>{ projected.x, projected.y, projected.z, projected.w };
+        double reach = std::abs(viewed.x) + std::abs(viewed.y) + std::abs(viewed.z) + 1.0;
+        agree = agree && close(fused, separate, reach);
+        worst = std::max(worst, std::abs(fused.w - separate.w) / std::max(1.0, reach));
+
+        if (!agree) {
+            fprintf(stderr, "Error: Float products disagree with the scalar ones on sample %d\n", k);
+            mismatches += 1;
+        }
+    }
+    printf("Math: %d of %d samples agree with the scalar products, fused MVP %.2g off at worst\n",
+        samples - mismatches, samples, worst);
+    return mismatches;
+}
+
+void math_bench(int vertices, int rounds)
+{
+    std::mt19937 rng(1);
+    std::uniform_real_distribution<double> position(-10.0, 10.0);
+    Matrix proj_matrix = Matrix::project(90.0, 0.75, 0.1, 1000.0);
+    Matrix world_matrix, view_matrix;
+    random_camera(rng, &world_matrix, &view_matrix);
+
+    std::vector<Vec> points(vertices);
+    std::vector<Vec4<float>> points_float(vertices);
+    for (int k = 0; k < vertices; ++k) {
+        points[k] = Vec{ position(rng), position(rng), position(rng) };
+        points_float[k] = Vec4<float>{ (float)points[k].x, (float)points[k].y, (float)points[k].z };
+    }
+    std::vector<Vec> out(vertices);
+    std::vector<Vec4<float>> out_float(vertices);
+
+    // best of the rounds, each transforms every vertex once like a frame does
+    double separate_ms = 1e30, fused_ms = 1e30;
+    for (int r = 0; r < rounds; ++r) {
+        auto start = std::chrono::steady_clock::now();
+        for (int k = 0; k < vertices; ++k) {
+            Vec transformed = Vec::matmul(points[k], world_matrix);
+            Vec viewed = Vec::matmul(transformed, view_matrix);
+            out[k] = Vec::matmul(viewed, proj_matrix);
+        }
+        auto middle = std::chrono::steady_clock::now();
+        Mat4<float> world_view = mul(to_mat4<float>(world_matrix), to_mat4<float>(view_matrix));
+        Mat4<float> mvp = mul(world_view, to_mat4<float>(proj_matrix));
+        for (int k = 0; k < vertices; ++k)
+            out_float[k] = mul(points_float[k], mvp);
+        auto end = std::chrono::steady_clock::now();
+        separate_ms = std::min(separate_ms, std::chrono::duration<double, std::milli>(middle - start).count());
+        fused_ms = std::min(fused_ms, std::chrono::duration<double, std::milli>(end - middle).count());
+    }
+    printf("Math: %d vertices, world/view/projection Matrix %.3f ms, fused MVP %.3f ms (%.1fx)\n",
+        vertices, separate_ms, fused_ms, separate_ms / fused_ms);
+}
+
+} // trace
@@ -0,0 +1,184 @@
+#pragma once
+
+#include <cmath>
+
+#if defined(__SSE__) || defined(_M_X64)
+#include <xmmintrin.h>
+#define TRACE_SSE 1
+#endif
+
+namespace trace {
+
+/******************************************************************************
+ * Math
+ *
+ * Value type vectors and a 4x4 matrix templated on the scalar type. They take
+ * const references and everything but normalize() is constexpr, so transforms
+ * known at compile time fold away. mul() has the same products for
+ * Mat4<float> at runtime, done with SSE when it's available, for the per
+ * vertex work. math_check() runs them against the scalar ones.
+ *
+ * Like Matrix, points are row vectors on the left, v' = v * M, so in A * B
+ * the transform A is applied first.
+ */
+
+template <typename T>
+struct Vec3 {
+    T x = 0;
+    T y = 0;
+    T z = 0;
+
+    constexpr Vec3() = default;
+    constexpr Vec3(T x, T y, T z) : x(x), y(y), z(z) {}
+
+    constexpr Vec3 operator+(const Vec3& v) const { return Vec3{ x + v.x, y + v.y, z + v.z }; }
+    constexpr Vec3 operator-(const Vec3& v) const { return Vec3{ x - v.x, y - v.y, z - v.z }; }
+    constexpr Vec3 operator*(T k) const { return Vec3{ x * k, y * k, z * k }; }
+    constexpr bool operator==(const Vec3& v) const { return x == v.x && y == v.y && z == v.z; }
+};
+
+template <typename T>
+struct Vec4 {
+    T x = 0;
+    T y = 0;
+    T z = 0;
+    T w = 1;
+
+    constexpr Vec4() = default;
+    constexpr Vec4(T x, T y, T z, T w = 1) : x(x), y(y), z(z), w(w) {}
+    constexpr explicit Vec4(const Vec3<T>& v, T w = 1) : x(v.x), y(v.y), z(v.z), w(w) {}
+
+    constexpr Vec3<T> xyz() const { return Vec3<T>{ x, y, z }; }
+    constexpr Vec4 operator+(const Vec4& v) const { return Vec4{ x + v.x, y + v.y, z + v.z, w + v.w }; }
+    constexpr Vec4 operator-(const Vec4& v) const { return Vec4{ x - v.x, y - v.y, z - v.z, w - v.w }; }
+    constexpr Vec4 operator*(T k) const { return Vec4{ x * k, y * k, z * k, w * k }; }
+    constexpr bool operator==(const Vec4& v) const { return x == v.x && y == v.y && z == v.z && w == v.w; }
+};
+
+template <typename T>
+struct Mat4 {
+    T m[4][4] = {};
+
+    static constexpr Mat4 identity() {
+        return Mat4{ { { 1, 0, 0, 0 }, { 0, 1, 0, 0 }, { 0, 0, 1, 0 }, { 0, 0, 0, 1 } } };
+    }
+
+    static constexpr Mat4 translate(T x, T y, T z) {
+        return Mat4{ { { 1, 0, 0, 0 }, { 0, 1, 0, 0 }, { 0, 0, 1, 0 }, { x, y, z, 1 } } };
+    }
+
+    constexpr Vec4<T> row(int i) const { return Vec4<T>{ m[i][0], m[i][1], m[i][2], m[i][3] }; }
+
+    constexpr bool operator==(const Mat4& o) const {
+        for (int i = 0; i < 4; i++) {
+            for (int j = 0; j < 4; j++) {
+                if (m[i][j] != o.m[i][j])
+                    return false;
+            }
+        }
+        return true;
+    }
+};
+
+template <typename T>
+constexpr T dot(const Vec3<T>& a, const Vec3<T>& b)
+{
+    return a.x * b.x + a.y * b.y + a.z * b.z;
+}
+
+template <typename T>
+constexpr Vec3<T> cross(const Vec3<T>& a, const Vec3<T>& b)
+{
+    return Vec3<T>{ a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x };
+}
+
+template <typename T>
+Vec3<T> normalize(const Vec3<T>& v)
+{
+    return v * (T(1) / std::sqrt(dot(v, v)));
+}
+
+template <typename T>
+constexpr Vec4<T> operator*(const Vec4<T>& v, const Mat4<T>& m)
+{
+    return Vec4<T>{
+        v.x * m.m[0][0] + v.y * m.m[1][0] + v.z * m.m[2][0] + v.w * m.m[3][0],
+        v.x * m.m[0][1] + v.y * m.m[1][1] + v.z * m.m[2][1] + v.w * m.m[3][1],
+        v.x * m.m[0][2] + v.y * m.m[1][2] + v.z * m.m[2][2] + v.w * m.m[3][2],
+        v.x * m.m[0][3] + v.y * m.m[1][3] + v.z * m.m[2][3] + v.w * m.m[3][3],
+    };
+}
+
+template <typename T>
+constexpr Mat4<T> operator*(const Mat4<T>& a, const Mat4<T>& b)
+{
+    Mat4<T> r;
+    for (int i = 0; i < 4; i++) {
+        Vec4<T> row = a.row(i) * b;
+        r.m[i][0] = row.x;
+        r.m[i][1] = row.y;
+        r.m[i][2] = row.z;
+        r.m[i][3] = row.w;
+    }
+    return r;
+}
+
+template <typename T, typename U>
+constexpr Mat4<T> mat4_cast(const Mat4<U>& m)
+{
+    Mat4<T> r;
+    for (int i = 0; i < 4; i++) {
+        for (int j = 0; j < 4; j++)
+            r.m[i][j] = (T)m.m[i][j];
+    }
+    return r;
+}
+
+static_assert(sizeof(Vec4<float>) == 4 * sizeof(float), "Vec4<float> is loaded as one __m128");
+static_assert(sizeof(Mat4<float>) == 16 * sizeof(float), "Mat4<float> rows are loaded as __m128");
+
+inline Vec4<float> mul(const Vec4<float>& v, const Mat4<float>& m)
+{
+#ifdef TRACE_SSE
+    __m128 r = _mm_mul_ps(_mm_set1_ps(v.x), _mm_loadu_ps(m.m[0]));
+    r = _mm_add_ps(r, _mm_mul_ps(_mm_set1_ps(v.y), _mm_loadu_ps(m.m[1])));
+    r = _mm_add_ps(r, _mm_mul_ps(_mm_set1_ps(v.z), _mm_loadu_ps(m.m[2])));
+    r = _mm_add_ps(r, _mm_mul_ps(_mm_set1_ps(v.w), _mm_loadu_ps(m.m[3])));
+    Vec4<float> out;
+    _mm_storeu_ps(&out.x, r);
+    return out;
+#else
+    return v * m;
+#endif
+}
+
+inline Mat4<float> mul(const Mat4<float>& a, const Mat4<float>& b)
+{
+    Mat4<float> r;
+    for (int i = 0; i < 4; i++) {
+        Vec4<float> row = mul(a.row(i), b);
+        r.m[i][0] = row.x;
+        r.m[i][1] = row.y;
+        r.m[i][2] = row.z;
+        r.m[i][3] = row.w;
+    }
+    return r;
+}
+
+// the float products against the scalar ones in double and the fused MVP
+// against Matrix, prints the summary and returns the mismatches
+int math_check(int samples, unsigned seed);
+// time the fused MVP against world, view and projection Matrix transforms
+void math_bench(int vertices, int rounds);
+
+// compile time checks of the product order, a swapped row or column fails these
+namespace math_checks {
+constexpr Mat4<int> counting = Mat4<int>{ { { 1, 2, 3, 4 }, { 5, 6, 7, 8 }, { 9, 10, 11, 12 }, { 13, 14, 15, 16 } } };
+static_assert(counting * Mat4<int>::identity() == counting, "Mat4 product is not A * I = A");
+static_assert(Mat4<int>::identity() * counting == counting, "Mat4 product is not I * A = A");
+static_assert((counting * counting).m[0][1] == 100 && (counting * counting).m[2][3] == 440, "Mat4 product");
+static_assert(Vec4<int>{ 1, 2, 3 } * Mat4<int>::translate(1, 1, 1) == Vec4<int>{ 2, 3, 4 }, "row vector times matrix");
+static_assert(Mat4<int>::translate(1, 0, 0) * Mat4<int>::translate(0, 2, 0) == Mat4<int>::translate(1, 2, 0), "translations compose");
+} // math_checks
+
+} // trace
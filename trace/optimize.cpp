@@ -0,0 +1,627 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <deque>
+#include <unordered_map>
+
+#include "optimize.hpp"
+
+namespace trace {
+
+static void rebuild_triangles(Mesh& mesh)
+{
+    mesh.triangles.clear();
+    for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3) {
+        mesh.triangles.push_back(Triangle{
+            mesh.vertices[mesh.indices[i]],
+            mesh.vertices[mesh.indices[i + 1]],
+            mesh.vertices[mesh.indices[i + 2]],
+        });
+    }
+}
+
+double acmr(const std::vector<uint32_t>& indices, int cache_size)
+{
+    if (indices.size() < 3)
+        return 0.0;
+
+    // misses push the oldest vertex out
+    std::deque<uint32_t> fifo;
+    size_t misses = 0;
+    for (uint32_t v : indices) {
+        if (std::find(fifo.begin(), fifo.end(), v) != fifo.end())
+            continue;
+        misses++;
+        fifo.push_back(v);
+        if ((int)fifo.size() > cache_size)
+            fifo.pop_front();
+    }
+    return (double)misses / (indices.size() / 3);
+}
+
+void weld_vertices(Mesh& mesh, double epsilon)
+{
+    if (mesh.vertices.empty() || epsilon <= 0)
+        return;
+
+    // hash grid with cells the size of epsilon, a match can only be in the 27 cells around a vertex
+    auto cell = [epsilon](double v) {
+        return (int64_t)std::floor(v / epsilon);
+    };
+    auto key = [](int64_t x, int64_t y, int64_t z) {
+        return ((uint64_t)(x & 0x1FFFFF) << 42) | ((uint64_t)(y & 0x1FFFFF) << 21) | (uint64_t)(z & 0x1FFFFF);
+    };
+
+    std::unordered_map<uint64_t, uint32_t> heads; // cell -> first welded vertex in it
+    std::vector<int64_t> next;                     // chain of welded vertices in the same cell
+    std::vector<Vec> welded;
+    std::vector<uint32_t> remap(mesh.vertices.size());
+    double epsilon2 = epsilon * epsilon;
+
+    for (size_t i = 0; i < mesh.vertices.size(); i++) {
+        Vec& v = mesh.vertices[i];
+        int64_t cx = cell(v.x), cy = cell(v.y), cz = cell(v.z);
+        int64_t found = -1;
+
+        for (int64_t dx = -1; dx <= 1 && found < 0; dx++) {
+            for (int64_t dy = -1; dy <= 1 && found < 0; dy++) {
+                for (int64_t dz = -1; dz <= 1 && found < 0; dz++) {
+                    auto head = heads.find(key(cx + dx, cy + dy, cz + dz));
+                    if (head == heads.end())
+                        continue;
+                    for (int64_t w = head->second; w >= 0; w = next[w]) {
+                        Vec& u = welded[w];
+                        double d2 = (u.x - v.x) * (u.x - v.x) + (u.y - v.y) * (u.y - v.y) + (u.z - v.z) * (u.z - v.z);
+                        if (d2 <= epsilon2) {
+                            found = w;
+                            break;
+                        }
+                    }
+                }
+            }
+        }
+
+        if (found < 0) {
+            found = (int64_t)welded.size();
+            welded.push_back(v);
+            uint64_t k = key(cx, cy, cz);
+            auto head = heads.find(k);
+            next.push_back(head == heads.end() ? -1 : (int64_t)head->second);
+            heads[k] = (uint32_t)found;
+        }
+        remap[i] = (uint32_t)found;
+    }
+
+    // remap indices, triangles that lost an edge are gone
+    std::vector<uint32_t> indices;
+    indices.reserve(mesh.indices.size());
+    for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3) {
+        uint32_t a = remap[mesh.indices[i]];
+        uint32_t b = remap[mesh.indices[i + 1]];
+        uint32_t c = remap[mesh.indices[i + 2]];
+        if (a == b || b == c || c == a)
+            continue;
+        indices.push_back(a);
+        indices.push_back(b);
+        indices.push_back(c);
+    }
+
+    mesh.vertices.swap(welded);
+    mesh.indices.swap(indices);
+}
+
+static float vertex_score(int cache_pos, uint32_t remaining)
+{
+    // no triangles left to use it
+    if (remaining == 0)
+        return -1.0f;
+
+    float score = 0.0f;
+    if (cache_pos >= 0) {
+        // the last triangle's vertices get a fixed score so it isn't favored to reuse them
+        if (cache_pos < 3)
+            score = 0.75f;
+        else
+            score = powf(1.0f - (float)(cache_pos - 3) / (VERTEX_CACHE_SIZE - 3), 1.5f);
+    }
+    // boost vertices with few triangles left to get rid of them
+    return score + 2.0f * powf((float)remaining, -0.5f);
+}
+
+void optimize_vertex_cache(uint32_t *indices, size_t count, size_t vertex_count)
+{
+    size_t tri_count = count / 3;
+    if (tri_count < 2)
+        return;
+
+    // work in cluster local vertex ids, only the entries this cluster sets are
+    // put back to -1 after so a mesh of many clusters doesn't refill the table
+    static std::vector<int32_t> remap;
+    if (remap.size() < vertex_count)
+        remap.resize(vertex_count, -1);
+    std::vector<uint32_t> global;
+    std::vector<uint32_t> local(count);
+    for (size_t i = 0; i < count; i++) {
+        if (remap[indices[i]] < 0) {
+            remap[indices[i]] = (int32_t)global.size();
+            global.push_back(indices[i]);
+        }
+        local[i] = (uint32_t)remap[indices[i]];
+    }
+    size_t n = global.size();
+    for (uint32_t v : global) {
+        remap[v] = -1;
+    }
+
+    // triangles around each vertex
+    std::vector<uint32_t> remaining(n, 0);
+    for (uint32_t v : local) {
+        remaining[v]++;
+    }
+    std::vector<uint32_t> offsets(n + 1, 0);
+    for (size_t v = 0; v < n; v++) {
+        offsets[v + 1] = offsets[v] + remaining[v];
+    }
+    std::vector<uint32_t> adjacent(count);
+    std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+    for (size_t i = 0; i < count; i++) {
+        adjacent[fill[local[i]]++] = (uint32_t)(i / 3);
+    }
+
+    std::vector<int> cache_pos(n, -1);
+    std::vector<float> vscore(n);
+    for (size_t v = 0; v < n; v++) {
+        vscore[v] = vertex_score(-1, remaining[v]);
+    }
+    std::vector<float> tscore(tri_count);
+    std::vector<char> emitted(tri_count, 0);
+    for (size_t t = 0; t < tri_count; t++) {
+        tscore[t] = vscore[local[t * 3]] + vscore[local[t * 3 + 1]] + vscore[local[t * 3 + 2]];
+    }
+
+    std::vector<uint32_t> cache;
+    std::vector<uint32_t> new_cache;
+    std::vector<uint32_t> out;
+    out.reserve(count);
+
+    int64_t best = std::max_element(tscore.begin(), tscore.end()) - tscore.begin();
+    for (size_t k = 0; k < tri_count; k++) {
+        if (best < 0) {
+            // nothing in the cache touches a triangle that is left, start over from the best one
+            float best_score = -INFINITY;
+            for (size_t t = 0; t < tri_count; t++) {
+                if (!emitted[t] && tscore[t] > best_score) {
+                    best_score = tscore[t];
+                    best = (int64_t)t;
+                }
+            }
+        }
+
+        emitted[best] = 1;
+        new_cache.clear();
+        for (int c = 0; c < 3; c++) {
+            uint32_t v = local[best * 3 + c];
+            out.push_back(global[v]);
+            new_cache.push_back(v);
+
+            // take the triangle out of the vertex's list
+            uint32_t *begin = &adjacent[offsets[v]];
+            uint32_t *end = begin + remaining[v];
+            *std::find(begin, end, (uint32_t)best) = *(end - 1);
+            remaining[v]--;
+        }
+
+        // most recent first, anything pushed past the end falls out of the cache
+        for (uint32_t v : cache) {
+            if (std::find(new_cache.begin(), new_cache.end(), v) == new_cache.end())
+                new_cache.push_back(v);
+        }
+        for (size_t c = 0; c < new_cache.size(); c++) {
+            uint32_t v = new_cache[c];
+            cache_pos[v] = c < (size_t)VERTEX_CACHE_SIZE ? (int)c : -1;
+            vscore[v] = vertex_score(cache_pos[v], remaining[v]);
+        }
+        if (new_cache.size() > (size_t)VERTEX_CACHE_SIZE)
+            new_cache.resize(VERTEX_CACHE_SIZE);
+        cache.swap(new_cache);
+
+        // rescore the triangles touching the cache and pick the next from them
+        best = -1;
+        float best_score = -INFINITY;
+        for (uint32_t v : cache) {
+            for (uint32_t a = offsets[v]; a < offsets[v] + remaining[v]; a++) {
+                uint32_t t = adjacent[a];
+                tscore[t] = vscore[local[t * 3]] + vscore[local[t * 3 + 1]] + vscore[local[t * 3 + 2]];
+                if (tscore[t] > best_score) {
+                    best_score = tscore[t];
+                    best = t;
+                }
+            }
+        }
+    }
+
+    std::copy(out.begin(), out.end(), indices);
+}
+
+void optimize_vertex_fetch(Mesh& mesh)
+{
+    std::vector<int64_t> remap(mesh.vertices.size(), -1);
+    std::vector<Vec> vertices;
+    vertices.reserve(mesh.vertices.size());
+    for (uint32_t& i : mesh.indices) {
+        if (remap[i] < 0) {
+            remap[i] = (int64_t)vertices.size();
+            vertices.push_back(mesh.vertices[i]);
+        }
+        i = (uint32_t)remap[i];
+    }
+    mesh.vertices.swap(vertices);
+}
+
+void build_meshlets(Mesh& mesh)
+{
+    size_t triangle_count = mesh.indices.size() / 3;
+    size_t vertex_count = mesh.vertices.size();
+    if (triangle_count == 0)
+        return;
+
+    auto position = [&](uint32_t v) {
+        return Vec3<double>{ mesh.vertices[v].x, mesh.vertices[v].y, mesh.vertices[v].z };
+    };
+    std::vector<Vec3<double>> normals(triangle_count);
+    std::vector<Vec3<double>> centroids(triangle_count);
+    double edge_sum = 0;
+    for (size_t t = 0; t < triangle_count; t++) {
+        Vec3<double> a = position(mesh.indices[t * 3]);
+        Vec3<double> b = position(mesh.indices[t * 3 + 1]);
+        Vec3<double> c = position(mesh.indices[t * 3 + 2]);
+        Vec3<double> n = cross(b - a, c - a);
+        normals[t] = dot(n, n) > 0 ? normalize(n) : Vec3<double>{};
+        centroids[t] = (a + b + c) * (1.0 / 3.0);
+        edge_sum += std::sqrt(dot(b - a, b - a));
+    }
+    // about how far a compact cluster reaches from its middle
+    double reach = std::max(1e-12, edge_sum / triangle_count * std::sqrt((double)CLUSTER_SIZE) * 0.5);
+
+    // triangles around each vertex
+    std::vector<uint32_t> offsets(vertex_count + 1, 0);
+    for (uint32_t v : mesh.indices) {
+        offsets[v + 1]++;
+    }
+    for (size_t v = 0; v < vertex_count; v++) {
+        offsets[v + 1] += offsets[v];
+    }
+    std::vector<uint32_t> adjacency(mesh.indices.size());
+    std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+    for (size_t i = 0; i < mesh.indices.size(); i++) {
+        adjacency[fill[mesh.indices[i]]++] = (uint32_t)(i / 3);
+    }
+
+    std::vector<char> used(triangle_count, 0);
+    std::vector<uint32_t> order;
+    std::vector<size_t> starts;
+    std::vector<uint32_t> candidates;
+    order.reserve(triangle_count);
+
+    // seeds are taken in the existing z-order so neighbouring clusters stay close
+    size_t seed = 0;
+    for (;;) {
+        while (seed < triangle_count && used[seed])
+            seed++;
+        if (seed == triangle_count)
+            break;
+
+        starts.push_back(order.size());
+        candidates.clear();
+        Vec3<double> axis = Vec3<double>{};
+        Vec3<double> middle = Vec3<double>{};
+        size_t count = 0;
+        uint32_t next = (uint32_t)seed;
+        for (;;) {
+            used[next] = 1;
+            order.push_back(next);
+            count++;
+            axis = axis + normals[next];
+            middle = middle + (centroids[next] - middle) * (1.0 / count);
+            if (count == CLUSTER_SIZE)
+                break;
+
+            for (int k = 0; k < 3; k++) {
+                uint32_t v = mesh.indices[next * 3 + k];
+                for (uint32_t i = offsets[v]; i < offsets[v + 1]; i++) {
+                    if (!used[adjacency[i]])
+                        candidates.push_back(adjacency[i]);
+                }
+            }
+
+            // grow toward the neighbour facing most like the cluster so far and
+            // nearest its middle, stop once every neighbour faces more than 90
+            // degrees away since the cluster's cone could never cull after that
+            Vec3<double> facing = dot(axis, axis) > 0 ? normalize(axis) : axis;
+            int64_t best = -1;
+            double best_score = -INFINITY;
+            size_t keep = 0;
+            for (uint32_t t : candidates) {
+                if (used[t])
+                    continue;
+                candidates[keep++] = t;
+                double dp = dot(normals[t], facing);
+                if (dp <= 0)
+                    continue;
+                Vec3<double> d = centroids[t] - middle;
+                double score = dp - std::sqrt(dot(d, d)) / reach;
+                if (score > best_score) {
+                    best_score = score;
+                    best = t;
+                }
+            }
+            candidates.resize(keep);
+
+            // disconnected pieces, keep filling from the triangles next in z-order
+            if (best < 0) {
+                int looked = 0;
+                for (size_t t = seed; t < triangle_count && looked < CLUSTER_SIZE; t++) {
+                    if (used[t])
+                        continue;
+                    looked++;
+                    double dp = dot(normals[t], facing);
+                    if (dp <= 0)
+                        continue;
+                    Vec3<double> d = centroids[t] - middle;
+                    double score = dp - std::sqrt(dot(d, d)) / reach;
+                    if (score > best_score) {
+                        best_score = score;
+                        best = (int64_t)t;
+                    }
+                }
+            }
+            if (best < 0)
+                break;
+            next = (uint32_t)best;
+        }
+    }
+
+    std::vector<uint32_t> indices;
+    indices.reserve(mesh.indices.size());
+    for (uint32_t t : order) {
+        for (int k = 0; k < 3; k++) {
+            indices.push_back(mesh.indices[t * 3 + k]);
+        }
+    }
+    mesh.indices.swap(indices);
+    rebuild_triangles(mesh);
+
+    mesh.clusters.clear();
+    starts.push_back(order.size());
+    for (size_t i = 0; i + 1 < starts.size(); i++) {
+        Cluster c;
+        c.first = starts[i];
+        c.count = starts[i + 1] - starts[i];
+        mesh.clusters.push_back(c);
+    }
+    mesh.build_bounds();
+}
+
+static uint64_t edge_key(uint32_t a, uint32_t b)
+{
+    return a < b ? (uint64_t)a << 32 | b : (uint64_t)b << 32 | a;
+}
+
+static Vec3<double> position_of(Mesh& mesh, uint32_t v)
+{
+    return Vec3<double>{ mesh.vertices[v].x, mesh.vertices[v].y, mesh.vertices[v].z };
+}
+
+// true if moving v onto its neighbour u leaves a surface of the same shape:
+// only the two vertices across edge (v, u) are next to both, and none of
+// the triangles that stay turn over or lose their area
+static bool collapse_valid(Mesh& mesh, std::vector<uint32_t>& tris, uint32_t v, uint32_t u)
+{
+    static std::vector<uint32_t> around_v, around_u, across;
+    around_v.clear();
+    around_u.clear();
+    across.clear();
+    for (size_t t = 0; t < tris.size(); t += 3) {
+        uint32_t* tri = &tris[t];
+        bool has_v = tri[0] == v || tri[1] == v || tri[2] == v;
+        bool has_u = tri[0] == u || tri[1] == u || tri[2] == u;
+        if (has_v && has_u) {
+            for (int k = 0; k < 3; k++) {
+                if (tri[k] != v && tri[k] != u)
+                    across.push_back(tri[k]);
+            }
+        }
+        else if (has_v) {
+            Vec3<double> p[3], q[3];
+            for (int k = 0; k < 3; k++) {
+                p[k] = position_of(mesh, tri[k]);
+                q[k] = position_of(mesh, tri[k] == v ? u : tri[k]);
+                if (tri[k] != v)
+                    around_v.push_back(tri[k]);
+            }
+            if (dot(cross(p[1] - p[0], p[2] - p[0]), cross(q[1] - q[0], q[2] - q[0])) <= 0)
+                return false;
+        }
+        else if (has_u) {
+            for (int k = 0; k < 3; k++) {
+                if (tri[k] != u)
+                    around_u.push_back(tri[k]);
+            }
+        }
+    }
+    if (across.size() != 2)
+        return false;
+    for (uint32_t w : around_v) {
+        if (w != across[0] && w != across[1] && std::find(around_u.begin(), around_u.end(), w) != around_u.end())
+            return false;
+    }
+    return true;
+}
+
+void build_cluster_lods(Mesh& mesh)
+{
+    size_t vertex_count = mesh.vertices.size();
+    mesh.lod_triangles.clear();
+    mesh.lod_indices.clear();
+
+    // vertices on an edge that isn't shared by exactly two triangles, or used
+    // by more than one cluster, hold the clusters together and stay put
+    std::unordered_map<uint64_t, int> edge_uses;
+    for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3) {
+        for (int k = 0; k < 3; k++) {
+            edge_uses[edge_key(mesh.indices[i + k], mesh.indices[i + (k + 1) % 3])]++;
+        }
+    }
+    std::vector<char> locked(vertex_count, 0);
+    std::vector<int64_t> owner(vertex_count, -1);
+    for (size_t c = 0; c < mesh.clusters.size(); c++) {
+        Cluster& cluster = mesh.clusters[c];
+        for (size_t i = cluster.first * 3; i < (cluster.first + cluster.count) * 3; i++) {
+            uint32_t v = mesh.indices[i];
+            if (owner[v] >= 0 && owner[v] != (int64_t)c)
+                locked[v] = 1;
+            owner[v] = (int64_t)c;
+        }
+    }
+    for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3) {
+        for (int k = 0; k < 3; k++) {
+            uint32_t a = mesh.indices[i + k];
+            uint32_t b = mesh.indices[i + (k + 1) % 3];
+            if (edge_uses[edge_key(a, b)] != 2)
+                locked[a] = locked[b] = 1;
+        }
+    }
+
+    std::vector<uint32_t> tris;
+    std::vector<uint32_t> used;
+    std::vector<uint32_t> moved_to(vertex_count);
+    size_t simplified = 0;
+    size_t before = 0;
+    size_t kept = 0;
+    for (Cluster& cluster : mesh.clusters) {
+        tris.assign(mesh.indices.begin() + cluster.first * 3, mesh.indices.begin() + (cluster.first + cluster.count) * 3);
+        used = tris;
+        std::sort(used.begin(), used.end());
+        used.erase(std::unique(used.begin(), used.end()), used.end());
+        for (uint32_t v : used) {
+            moved_to[v] = v;
+        }
+
+        // collapse the shortest edge that can go until enough triangles are gone
+        size_t target = (size_t)std::ceil(cluster.count * LOD_KEEP);
+        while (tris.size() / 3 > target) {
+            double best = INFINITY;
+            uint32_t best_v = 0, best_u = 0;
+            auto consider = [&](uint32_t v, uint32_t u) {
+                if (locked[v])
+                    return;
+                Vec3<double> d = position_of(mesh, u) - position_of(mesh, v);
+                double length = dot(d, d);
+                if (length < best && collapse_valid(mesh, tris, v, u)) {
+                    best = length;
+                    best_v = v;
+                    best_u = u;
+                }
+            };
+            for (size_t t = 0; t < tris.size(); t += 3) {
+                for (int k = 0; k < 3; k++) {
+                    consider(tris[t + k], tris[t + (k + 1) % 3]);
+                    consider(tris[t + (k + 1) % 3], tris[t + k]);
+                }
+            }
+            if (best == INFINITY)
+                break;
+
+            size_t keep = 0;
+            for (size_t t = 0; t < tris.size(); t += 3) {
+                uint32_t tri[3] = { tris[t], tris[t + 1], tris[t + 2] };
+                if ((tri[0] == best_v || tri[1] == best_v || tri[2] == best_v)
+                        && (tri[0] == best_u || tri[1] == best_u || tri[2] == best_u))
+                    continue;
+                for (int k = 0; k < 3; k++) {
+                    tris[keep++] = tri[k] == best_v ? best_u : tri[k];
+                }
+            }
+            tris.resize(keep);
+            for (uint32_t v : used) {
+                if (moved_to[v] == best_v)
+                    moved_to[v] = best_u;
+            }
+        }
+
+        cluster.lod_first = mesh.lod_triangles.size();
+        cluster.lod_count = 0;
+        cluster.lod_error = 0;
+        if (tris.size() / 3 == cluster.count)
+            continue;
+        double error = 0;
+        for (uint32_t v : used) {
+            Vec3<double> d = position_of(mesh, moved_to[v]) - position_of(mesh, v);
+            error = std::max(error, std::sqrt(dot(d, d)));
+        }
+        cluster.lod_count = tris.size() / 3;
+        // rounded out like the bounding sphere
+        cluster.lod_error = (float)error * 1.0001f;
+        for (size_t t = 0; t < tris.size(); t += 3) {
+            mesh.lod_indices.insert(mesh.lod_indices.end(), tris.begin() + t, tris.begin() + t + 3);
+            mesh.lod_triangles.push_back(Triangle{ mesh.vertices[tris[t]], mesh.vertices[tris[t + 1]], mesh.vertices[tris[t + 2]] });
+        }
+        simplified++;
+        before += cluster.count;
+        kept += cluster.lod_count;
+    }
+
+    printf("lod: %zu of %zu clusters simplified, %zu -> %zu triangles in them\n",
+        simplified, mesh.clusters.size(), before, kept);
+}
+
+void optimize_mesh(Mesh& mesh)
+{
+    size_t vertices_before = mesh.vertices.size();
+    size_t triangles_before = mesh.indices.size() / 3;
+    // the cache the reordering is tuned for, and a smaller one it should still help
+    double acmr_before = acmr(mesh.indices, VERTEX_CACHE_SIZE);
+    double acmr_small_before = acmr(mesh.indices, VERTEX_CACHE_SMALL);
+
+    // weld relative to the size of the mesh
+    Vec lo = Vec{ INFINITY, INFINITY, INFINITY };
+    Vec hi = Vec{ -INFINITY, -INFINITY, -INFINITY };
+    for (Vec& v : mesh.vertices) {
+        lo = Vec{ std::min(lo.x, v.x), std::min(lo.y, v.y), std::min(lo.z, v.z) };
+        hi = Vec{ std::max(hi.x, v.x), std::max(hi.y, v.y), std::max(hi.z, v.z) };
+    }
+    weld_vertices(mesh, WELD_EPSILON * Vec::dist(lo, hi));
+    rebuild_triangles(mesh);
+
+    // clusters keep their triangles, only the order inside of them changes
+    mesh.build_clusters();
+    build_meshlets(mesh);
+    // clusters of CLUSTER_SIZE can cost locality a long strip had, the
+    // reordering is measured against the order they come out in
+    double acmr_clustered = acmr(mesh.indices, VERTEX_CACHE_SIZE);
+    double acmr_small_clustered = acmr(mesh.indices, VERTEX_CACHE_SMALL);
+    // a cluster keeps the order it has when reordering wouldn't miss less
+    size_t reordered = 0;
+    std::vector<uint32_t> before, after;
+    for (Cluster& cluster : mesh.clusters) {
+        uint32_t *indices = &mesh.indices[cluster.first * 3];
+        before.assign(indices, indices + cluster.count * 3);
+        optimize_vertex_cache(indices, cluster.count * 3, mesh.vertices.size());
+        after.assign(indices, indices + cluster.count * 3);
+        if (acmr(after, VERTEX_CACHE_SIZE) < acmr(before, VERTEX_CACHE_SIZE))
+            reordered++;
+        else
+            std::copy(before.begin(), before.end(), indices);
+    }
+    optimize_vertex_fetch(mesh);
+    rebuild_triangles(mesh);
+
+    printf("mesh: %zu -> %zu vertices, %zu -> %zu triangles, ACMR(%d) %.3f -> %.3f clustered -> %.3f, ACMR(%d) %.3f -> %.3f -> %.3f, %zu clusters, %zu reordered\n",
+        vertices_before, mesh.vertices.size(),
+        triangles_before, mesh.indices.size() / 3,
+        VERTEX_CACHE_SIZE, acmr_before, acmr_clustered, acmr(mesh.indices, VERTEX_CACHE_SIZE),
+        VERTEX_CACHE_SMALL, acmr_small_before, acmr_small_clustered, acmr(mesh.indices, VERTEX_CACHE_SMALL),
+        mesh.clusters.size(), reordered);
+}
+
+} // trace
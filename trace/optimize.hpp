@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "types.hpp"
+
+namespace trace {
+
+/******************************************************************************
+ * Mesh Optimization
+ *
+ * Load time clean up of *.obj meshes: weld duplicate vertices, order each
+ * cluster's triangles for the post-transform vertex cache (Forsyth, "Linear-
+ * Speed Vertex Cache Optimisation") and order vertices by first use. Each
+ * cluster then gets a simplified copy for when it's far enough away.
+ *
+ * https://tomforsyth1000.github.io/papers/fast_vert_cache_opt.html
+ */
+
+// average cache miss ratio, transformed vertices per triangle with a FIFO cache
+double acmr(const std::vector<uint32_t>& indices, int cache_size);
+
+// merge vertices closer than epsilon, drops triangles that collapse
+void weld_vertices(Mesh& mesh, double epsilon);
+// reorder indices[first, first + count) for vertex cache hits
+void optimize_vertex_cache(uint32_t *indices, size_t count, size_t vertex_count);
+// renumber vertices in order of first use, drops unused ones
+void optimize_vertex_fetch(Mesh& mesh);
+
+// regroup the triangles into clusters grown across shared vertices, keeping
+// each cluster's normals within a cone where possible so it can be culled whole
+void build_meshlets(Mesh& mesh);
+
+// weld, cluster and reorder, printing the before and after
+void optimize_mesh(Mesh& mesh);
+
+// give each cluster a coarse level by collapsing edges toward LOD_KEEP of its
+// triangles. Vertices on the cluster's border never move, so a coarse cluster
+// meets its neighbours at either level without cracks
+void build_cluster_lods(Mesh& mesh);
+
+} // trace
@@ -0,0 +1,115 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+#include "packed.hpp"
+
+namespace trace {
+
+void PackedMesh::build(Mesh& mesh)
+{
+    this->vertices.clear();
+    this->indices16.clear();
+    this->indices32.clear();
+    this->clusters.clear();
+
+    this->wide = 3 * CLUSTER_SIZE > UINT16_MAX;
+
+    // mesh vertex -> cluster vertex, reset after each cluster
+    std::vector<int32_t> remap(mesh.vertices.size(), -1);
+    std::vector<uint32_t> used;
+
+    for (Cluster& cluster : mesh.clusters) {
+        PackedCluster pc;
+        pc.first_vertex = (uint32_t)this->vertices.size();
+        pc.first_index = (uint32_t)(this->wide ? this->indices32.size() : this->indices16.size());
+        pc.triangle_count = (uint32_t)cluster.count;
+        pc.origin = cluster.bmin;
+        pc.scale = Vec{
+            (cluster.bmax.x - cluster.bmin.x) / 65535.0,
+            (cluster.bmax.y - cluster.bmin.y) / 65535.0,
+            (cluster.bmax.z - cluster.bmin.z) / 65535.0,
+            0,
+        };
+
+        auto quantize = [](double v, double origin, double scale) {
+            return scale > 0 ? (uint16_t)std::lround(std::clamp((v - origin) / scale, 0.0, 65535.0)) : (uint16_t)0;
+        };
+
+        for (size_t i = cluster.first * 3; i < (cluster.first + cluster.count) * 3; i++) {
+            uint32_t v = mesh.indices[i];
+            if (remap[v] < 0) {
+                remap[v] = (int32_t)(this->vertices.size() - pc.first_vertex);
+                used.push_back(v);
+
+                PackedVertex pv;
+                pv.x = quantize(mesh.vertices[v].x, pc.origin.x, pc.scale.x);
+                pv.y = quantize(mesh.vertices[v].y, pc.origin.y, pc.scale.y);
+                pv.z = quantize(mesh.vertices[v].z, pc.origin.z, pc.scale.z);
+                this->vertices.push_back(pv);
+            }
+            if (this->wide)
+                this->indices32.push_back((uint32_t)remap[v]);
+            else
+                this->indices16.push_back((uint16_t)remap[v]);
+        }
+
+        // the coarse level was collapsed onto the cluster's own vertices
+        pc.lod_first_index = (uint32_t)(this->wide ? this->indices32.size() : this->indices16.size());
+        pc.lod_triangle_count = (uint32_t)cluster.lod_count;
+        for (size_t i = cluster.lod_first * 3; i < (cluster.lod_first + cluster.lod_count) * 3; i++) {
+            uint32_t v = mesh.lod_indices[i];
+            if (this->wide)
+                this->indices32.push_back((uint32_t)remap[v]);
+            else
+                this->indices16.push_back((uint16_t)remap[v]);
+        }
+
+        pc.vertex_count = (uint32_t)(this->vertices.size() - pc.first_vertex);
+        for (uint32_t v : used) {
+            remap[v] = -1;
+        }
+        used.clear();
+        this->clusters.push_back(pc);
+    }
+}
+
+PackedTransform PackedMesh::transform(size_t c, const Mat4<float>& mvp, const Vec3<float>& eye)
+{
+    PackedCluster& pc = this->clusters[c];
+    Vec3<float> scale = Vec3<float>{ (float)pc.scale.x, (float)pc.scale.y, (float)pc.scale.z };
+    Vec3<float> origin = Vec3<float>{ (float)pc.origin.x, (float)pc.origin.y, (float)pc.origin.z };
+    Mat4<float> dequantize = Mat4<float>{ {
+        { scale.x, 0, 0, 0 },
+        { 0, scale.y, 0, 0 },
+        { 0, 0, scale.z, 0 },
+        { origin.x, origin.y, origin.z, 1 },
+    } };
+
+    // a face normal n of quantized positions is (sy sz nx, sx sz ny, sx sy nz)
+    // in model space, and its dot with p - eye is volume (n . q) + n . eye_offset
+    PackedTransform t;
+    t.mvp = mul(dequantize, mvp);
+    t.normal_scale = Vec3<float>{ scale.y * scale.z, scale.x * scale.z, scale.x * scale.y };
+    Vec3<float> offset = origin - eye;
+    t.eye_offset = Vec3<float>{ offset.x * t.normal_scale.x, offset.y * t.normal_scale.y, offset.z * t.normal_scale.z };
+    t.volume = scale.x * scale.y * scale.z;
+    return t;
+}
+
+size_t PackedMesh::bytes()
+{
+    return this->vertices.size() * sizeof(PackedVertex)
+        + this->indices16.size() * sizeof(uint16_t)
+        + this->indices32.size() * sizeof(uint32_t)
+        + this->clusters.size() * sizeof(PackedCluster);
+}
+
+void PackedMesh::print()
+{
+    size_t n = std::max((size_t)1, this->vertices.size());
+    printf("packed: %zu vertices, %zu bytes/vertex, %zu bytes total (%.2f bytes/vertex with indices)\n",
+        this->vertices.size(), sizeof(PackedVertex), this->bytes(), (double)this->bytes() / n);
+}
+
+} // trace
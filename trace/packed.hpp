@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "types.hpp"
+
+namespace trace {
+
+/******************************************************************************
+ * Packed Mesh
+ *
+ * Compressed copy of a clustered mesh. Each cluster owns its vertices, which
+ * are quantized to 16 bits per axis against the cluster bounds, 6 bytes each.
+ * Indices are cluster relative so they fit in 16 bits unless CLUSTER_SIZE is
+ * raised past 21845 triangles.
+ *
+ * Nothing is unpacked to draw it. The cluster's scale and offset are folded
+ * into its transform, so the 16 bit positions go straight to clip space, and
+ * faces are tested and lit with normals taken from the quantized positions,
+ * the same face normals the unpacked mesh is lit by.
+ */
+
+struct PackedVertex {
+    uint16_t x, y, z;
+};
+
+struct PackedCluster {
+    uint32_t first_vertex = 0;
+    uint32_t vertex_count = 0;
+    uint32_t first_index = 0;
+    uint32_t triangle_count = 0;
+    uint32_t lod_first_index = 0; // coarse level, same vertices
+    uint32_t lod_triangle_count = 0;
+    Vec origin = Vec{}; // cluster bmin
+    Vec scale = Vec{};  // cluster extent / 65535
+};
+
+// a packed cluster set up for one frame
+struct PackedTransform {
+    Mat4<float> mvp = Mat4<float>::identity(); // dequantize, then model-view-projection
+    Vec3<float> normal_scale = Vec3<float>{};  // quantized face normal to model space, up to length
+    Vec3<float> eye_offset = Vec3<float>{};    // cluster origin - eye, times normal_scale
+    float volume = 0;                          // product of the cluster's scales
+};
+
+struct PackedMesh {
+    std::vector<PackedVertex> vertices;
+    std::vector<uint16_t> indices16;
+    std::vector<uint32_t> indices32;
+    std::vector<PackedCluster> clusters; // parallel to Mesh::clusters
+    bool wide = false; // indices32 in use
+
+    // compress a mesh after Mesh::build_clusters
+    void build(Mesh& mesh);
+    // cluster c's positions are origin + scale * q, fold that into mvp and the eye
+    PackedTransform transform(size_t c, const Mat4<float>& mvp, const Vec3<float>& eye);
+    // cluster relative vertices of triangle i of cluster c or its coarse level
+    void triangle(size_t c, size_t i, bool coarse, uint32_t out[3]) const {
+        const PackedCluster& pc = this->clusters[c];
+        size_t first = (coarse ? pc.lod_first_index : pc.first_index) + i * 3;
+        for (int k = 0; k < 3; k++) {
+            out[k] = this->wide ? this->indices32[first + k] : this->indices16[first + k];
+        }
+    }
+    size_t bytes();
+    void print();
+};
+
+} // trace
@@ -0,0 +1,1053 @@
+#include <cassert>
+#include <cstdio>
+#include <cstdlib>
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <string>
+#include <vector>
+
+#include "../../modules.hpp"
+#include "../geom/tri2d.hpp"
+#include "../prof/counters.hpp"
+#include "../prof/timing.hpp"
+#include "../prof/zones.hpp"
+#include "globals.hpp"
+#include "governor.hpp"
+#include "edges.hpp"
+#include "framebuffer.hpp"
+#include "hiz.hpp"
+#include "optimize.hpp"
+#include "packed.hpp"
+#include "types.hpp"
+#include "worker.hpp"
+
+namespace trace {
+
+enum Coverage {
+    COVERAGE_SAMPLES,    // may cover a pixel center
+    COVERAGE_DEGENERATE, // zero area
+    COVERAGE_MISSES,     // has area but no pixel center inside
+};
+
+// snap a screen coordinate to the subpixel grid
+static float snap(float v) {
+    constexpr float scale = (float)(1 << SUBPIXEL_BITS);
+    return std::round(v * scale) / scale;
+}
+
+// classify a snapped screen triangle by the pixel centers it can reach,
+// triangles with a single center in their bounds get it tested exactly
+static Coverage coverage(const Vec4<float>& a, const Vec4<float>& b, const Vec4<float>& c) {
+    float area = (b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x);
+    if (area == 0)
+        return COVERAGE_DEGENERATE;
+
+    // first and last pixel center inside the bounds on each axis
+    float x0 = std::ceil(std::min({ a.x, b.x, c.x }) - 0.5f);
+    float x1 = std::floor(std::max({ a.x, b.x, c.x }) - 0.5f);
+    float y0 = std::ceil(std::min({ a.y, b.y, c.y }) - 0.5f);
+    float y1 = std::floor(std::max({ a.y, b.y, c.y }) - 0.5f);
+    if (x0 > x1 || y0 > y1)
+        return COVERAGE_MISSES;
+    if (x0 < x1 || y0 < y1)
+        return COVERAGE_SAMPLES;
+
+    float px = x0 + 0.5f;
+    float py = y0 + 0.5f;
+    float sign = area > 0 ? 1.0f : -1.0f;
+    float e0 = sign * ((c.x - b.x) * (py - b.y) - (c.y - b.y) * (px - b.x));
+    float e1 = sign * ((a.x - c.x) * (py - c.y) - (a.y - c.y) * (px - c.x));
+    float e2 = sign * ((b.x - a.x) * (py - a.y) - (b.y - a.y) * (px - a.x));
+    return e0 >= 0 && e1 >= 0 && e2 >= 0 ? COVERAGE_SAMPLES : COVERAGE_MISSES;
+}
+
+// output of the geometry stage for one frame, handed to raster()
+struct Frame {
+    std::vector<Triangle> triangles;
+    int width = 0;          // render resolution it was projected for
+    int height = 0;
+    double geometry_ms = 0;
+    std::chrono::steady_clock::time_point latched; // when its camera was read
+    bool ready = false;     // made and not drawn yet
+};
+
+// everything besides the camera that changes what gets drawn
+struct FrameState {
+    uint32_t flags = 0;     // the use_* toggles
+    int width = 0;          // render resolution
+    int height = 0;
+    double lod_error = -1;  // the governor's, which clusters are drawn coarse
+
+    bool operator==(const FrameState& o) const {
+        return this->flags == o.flags && this->width == o.width && this->height == o.height && this->lod_error == o.lod_error;
+    }
+    bool operator!=(const FrameState& o) const { return !(*this == o); }
+};
+
+struct Graphics {
+    std::vector<Triangle> triangles_to_raster = std::vector<Triangle>{};
+    Mesh mesh = Mesh{};
+    Matrix proj_matrix;
+    Matrix world_matrix;
+    // per frame, model-view-projection and the camera and light moved into object space
+    Mat4<float> mvp = Mat4<float>::identity();
+    Vec3<float> eye = Vec3<float>{};
+    Vec3<float> light = Vec3<float>{};
+    Vec4<float> frustum[6]; // object space planes, xyz . p + w >= 0 inside
+    Vec camera = Vec{};
+    Vec look_dir = Vec{};
+    Vec up_vec = Vec{ 0.0, -1.0, 0.0 };
+    double yaw = 0.0;
+    double speed = 10.0;
+    double near = 0.1;
+    double far = 1000.0;
+    double fov = 90.0;
+    double aspect_ratio;
+    int screen_height;        // render resolution, the display size times governor.scale
+    int screen_width;
+    int display_height;
+    int display_width;
+    HiZ hiz = HiZ{};
+    bool use_hiz = true;
+    PackedMesh packed = PackedMesh{};
+    bool use_packed = false;
+    std::vector<PackedTransform> packed_transforms; // per cluster, for this frame
+    std::vector<Vec4<float>> packed_clip;           // vertices of the cluster being processed, in clip space
+    std::vector<uint8_t> packed_done;               // which of them are in packed_clip yet
+    EdgeList edges = EdgeList{};
+    LineBatch lines = LineBatch{};
+    Framebuffer framebuffer = Framebuffer{};
+    bool use_edges = false;
+    bool use_fill = false;
+    Governor governor = Governor{};
+    bool use_governor = true;
+    double governor_ms = 0; // last drawn frame's time, not fed to the governor yet
+    // visible triangles of the last full frame, back to front
+    std::vector<uint32_t> temporal_order;
+    std::vector<uint8_t> temporal_seen;
+    Vec temporal_camera = Vec{};
+    double temporal_yaw = 0.0;
+    FrameState temporal_state = FrameState{};
+    int temporal_age = 0;
+    bool use_temporal = true;
+    // pipelined, each update uploads the frame drawn last update while a
+    // worker rasters the one made last update and another makes the next
+    Frame frames[2];
+    Worker geometry_worker{ "trace geometry" };
+    Worker raster_worker{ "trace raster" };
+    bool use_pipeline = true;
+    bool drawn = false; // the framebuffer's back buffer holds a frame to swap in
+    std::chrono::steady_clock::time_point drawn_latched; // when its camera was read
+    // what the last presented frame was drawn with
+    Vec last_camera = Vec{};
+    double last_yaw = 0.0;
+    FrameState last_state = FrameState{};
+    Stats stats = Stats{};
+    
+    Graphics(const char *path, int screen_height, int screen_width) {
+        this->mesh.load(path);
+        optimize_mesh(this->mesh);
+        build_cluster_lods(this->mesh);
+        this->packed.build(this->mesh);
+        this->edges.build(this->mesh);
+        this->aspect_ratio = (double)screen_height / (double)screen_width;
+        this->screen_height = screen_height;
+        this->screen_width = screen_width;
+        this->display_height = screen_height;
+        this->display_width = screen_width;
+        this->proj_matrix = Matrix::project(this->fov, this->aspect_ratio, this->near, this->far);
+        // the mesh doesn't move, its world transform is built once
+        Matrix rotz_matrix = Matrix::rotate_z(0.0);
+        Matrix rotx_matrix = Matrix::rotate_x(0.0);
+        Matrix trans_matrix = Matrix::translate(0.0, 0.0, 5.0);
+        this->world_matrix = Matrix::matmul(rotz_matrix, rotx_matrix);
+        this->world_matrix = Matrix::matmul(this->world_matrix, trans_matrix);
+        this->hiz.resize(screen_width, screen_height);
+    }
+
+    // clip to the screen, resolve and draw a frame made by geometry() into
+    // the framebuffer's back buffer, on either thread
+    void raster(Frame& frame) {
+        PROF_ZONE("raster");
+        static Triangle test;
+        static int tris_to_add;
+        static int i, j;
+        static int new_triangles;
+        static std::deque<Triangle> triangles;
+        static std::vector<Triangle> to_draw;
+        static Triangle clipped[2];
+
+        for (Triangle tri_to_raster : frame.triangles) {
+            // clip triangles against screen edges
+            clipped[0] = Triangle{};
+            clipped[1] = Triangle{};
+            triangles.clear();
+            // add initial triangle
+            triangles.push_back(tri_to_raster);
+            new_triangles = 1;
+
+            for (i = 0; i < 4; i++) {
+                tris_to_add = 0;
+                while (new_triangles > 0) {
+                    test = triangles.front();
+                    triangles.pop_front();
+                    new_triangles -= 1;
+
+                    // top screen clip
+                    switch (i) {
+                        case 0: {
+                            Vec v1 = Vec{ 0, 0, 0 };
+                            Vec v2 = Vec{ 0, 1, 0 };
+                            tris_to_add = Triangle::clip_against_plane(v1, v2, test, clipped[0], clipped[1]);
+                            break;
+                        }
+                        // bottom screen clip
+                        case 1: {
+                            Vec v1 = Vec{ 0.0, (double)frame.height - 1, 0.0 };
+                            Vec v2 = Vec{ 0.0, -1.0, 0.0 };
+                            tris_to_add = Triangle::clip_against_plane(v1, v2, test, clipped[0], clipped[1]);
+                            break;
+                        }
+                        // left screen clip
+                        case 2: {
+                            Vec v1 = Vec{ 0.0, 0.0, 0.0 };
+                            Vec v2 = Vec{ 1.0, 0.0, 0.0 };
+                            tris_to_add = Triangle::clip_against_plane(v1, v2, test, clipped[0], clipped[1]);
+                            break;
+                        }
+                        // right screen clip
+                        case 3: {
+                            Vec v1 = Vec{ (double)frame.width - 1.0, 0.0, 0.0 };
+                            Vec v2 = Vec{ -1.0, 0.0, 0.0 };
+                            tris_to_add = Triangle::clip_against_plane(v1, v2, test, clipped[0], clipped[1]);
+                            break;
+                        }
+                    }
+
+                    // add the new triangles to the back of the queue
+                    for (j = 0; j < tris_to_add; j++) {
+                        clipped[j].distance = tri_to_raster.distance;
+                        triangles.push_back(clipped[j]);
+                    }
+                } // end while
+                new_triangles = (int)triangles.size();
+            } // end for
+
+            // triangles have screen space coordinates
+            for (Triangle t : triangles) {
+                to_draw.push_back(t);
+            }
+        }
+
+        std::sort(to_draw.rbegin(), to_draw.rend(), [](Triangle & t1, Triangle & t2) {
+            // distance defaults to 0 but it should be set, if this fails, then something else is wrong!
+            return t1.distance < t2.distance;
+        });
+
+        this->framebuffer.resize(frame.width, frame.height);
+        this->framebuffer.use_depth = this->use_fill;
+        this->framebuffer.clear(pack_color(SDL_Color{ 0, 0, 0, 255 }));
+
+        // filled triangles are resolved by the depth buffer
+        if (this->use_fill) {
+            for (Triangle& t : to_draw)
+                fill_triangle(this->framebuffer, t, pack_color(t.shade));
+            to_draw.clear();
+            return;
+        }
+
+        // remove triangles inside a closer one, furthest away in front, closest in back
+        static geom::Triangles screen;
+        screen.clear();
+        for (Triangle& t : to_draw) {
+            screen.push(geom::Tri{
+                (int32_t)std::lround(t.p[0].x), (int32_t)std::lround(t.p[0].y),
+                (int32_t)std::lround(t.p[1].x), (int32_t)std::lround(t.p[1].y),
+                (int32_t)std::lround(t.p[2].x), (int32_t)std::lround(t.p[2].y),
+            });
+        }
+        for (size_t i = 0; i < to_draw.size(); i++) {
+            to_draw[i].covered = geom::find_containing(screen, i + 1, to_draw.size(), screen.get(i)) != to_draw.size();
+        }
+
+        // outlines go into the framebuffer which is uploaded once, not a draw call per triangle
+        this->lines.clear();
+        for (Triangle& t : to_draw) {
+            if (t.covered)
+                continue;
+            uint32_t color = pack_color(t.shade);
+            this->lines.push(t.p[0].x, t.p[0].y, t.p[1].x, t.p[1].y, color);
+            this->lines.push(t.p[1].x, t.p[1].y, t.p[2].x, t.p[2].y, color);
+            this->lines.push(t.p[2].x, t.p[2].y, t.p[0].x, t.p[0].y, color);
+        }
+        draw_lines(this->framebuffer, this->lines);
+        to_draw.clear();
+    }
+
+    void input() {
+        Vec forward_vec = Vec::mul(this->look_dir, this->speed * Ctx->delta_time);
+        Vec right_vec = Vec::cross(this->look_dir, this->up_vec);
+        right_vec = Vec::mul(right_vec, this->speed * Ctx->delta_time);
+        // forward
+        if (Ctx->check_key(SDL_SCANCODE_W))
+            this->camera = Vec::add(this->camera, forward_vec);
+        // backward
+        if (Ctx->check_key(SDL_SCANCODE_S))
+            this->camera = Vec::sub(this->camera, forward_vec);
+        // up
+        if (Ctx->check_key(SDL_SCANCODE_SPACE))
+            this->camera.y += this->speed * Ctx->delta_time;
+        // down
+        if (Ctx->check_key(SDL_SCANCODE_LSHIFT))
+            this->camera.y -= this->speed * Ctx->delta_time;
+        // left
+        if (Ctx->check_key(SDL_SCANCODE_A))
+            this->camera = Vec::add(this->camera, right_vec);
+        // right
+        if (Ctx->check_key(SDL_SCANCODE_D))
+            this->camera = Vec::sub(this->camera, right_vec);
+        // turn left
+        if (Ctx->check_key(SDL_SCANCODE_LEFT))
+            this->yaw -= 0.1;
+        // turn right
+        if (Ctx->check_key(SDL_SCANCODE_RIGHT))
+            this->yaw += 0.1;
+        if (Ctx->check_key(SDL_SCANCODE_LCTRL))
+            this->speed = 300;
+        else
+            this->speed = 10;
+        // toggle occlusion culling
+        if (Ctx->check_key_invalidate(SDL_SCANCODE_O)) {
+            this->use_hiz = !this->use_hiz;
+            printf("Occlusion culling: %s\n", this->use_hiz ? "on" : "off");
+        }
+        // toggle drawing from the packed mesh
+        if (Ctx->check_key_invalidate(SDL_SCANCODE_C)) {
+            this->use_packed = !this->use_packed;
+            printf("Packed mesh: %s\n", this->use_packed ? "on" : "off");
+            printf("triangles: %zu bytes\n", this->mesh.triangles.size() * sizeof(Triangle));
+            this->packed.print();
+        }
+        // toggle the edge list wireframe
+        if (Ctx->check_key_invalidate(SDL_SCANCODE_E)) {
+            this->use_edges = !this->use_edges;
+            printf("Edge wireframe: %s (%zu edges for %zu triangles)\n",
+                this->use_edges ? "on" : "off", this->edges.v0.size(), this->mesh.triangles.size());
+        }
+        // toggle filled, depth tested triangles
+        if (Ctx->check_key_invalidate(SDL_SCANCODE_F)) {
+            this->use_fill = !this->use_fill;
+            printf("Depth tested fill: %s\n", this->use_fill ? "on" : "off");
+        }
+        // toggle the frame time governor
+        if (Ctx->check_key_invalidate(SDL_SCANCODE_G)) {
+            this->use_governor = !this->use_governor;
+            if (!this->use_governor) {
+                this->governor.reset();
+                apply_governor();
+            }
+            printf("Frame time governor: %s (target %.1f ms)\n", this->use_governor ? "on" : "off", this->governor.target_ms);
+        }
+        // toggle reuse of the last frame's visible set
+        if (Ctx->check_key_invalidate(SDL_SCANCODE_T)) {
+            this->use_temporal = !this->use_temporal;
+            printf("Temporal reuse: %s\n", this->use_temporal ? "on" : "off");
+        }
+        // toggle overlapping geometry and raster of consecutive frames
+        if (Ctx->check_key_invalidate(SDL_SCANCODE_L)) {
+            this->use_pipeline = !this->use_pipeline;
+            printf("Pipelined frames: %s\n", this->use_pipeline ? "on" : "off");
+        }
+        // print last frame's stats
+        if (Ctx->check_key_invalidate(SDL_SCANCODE_P)) {
+            this->stats.print();
+            prof::counters_report();
+            prof::modules_report();
+        }
+        // check the float products against the scalar ones and time the fused MVP
+        if (Ctx->check_key_invalidate(SDL_SCANCODE_M)) {
+            math_check(MATH_CHECK_SAMPLES, 0);
+            math_bench(MATH_BENCH_VERTICES, MATH_BENCH_ROUNDS);
+        }
+        // write the last few seconds of zones for Perfetto
+        if (Ctx->check_key_invalidate(SDL_SCANCODE_Z))
+            prof::zones_dump("trace_zones.json", prof::ZONE_DUMP_SECONDS);
+    }
+
+    // grayscale by how much a face's object space normal faces the light
+    SDL_Color shade_of(const Vec3<float>& normal) {
+        float light_dp = std::max(0.1f, dot(this->light, normal));
+        unsigned char grayscale = (unsigned char)std::abs(255 * light_dp);
+        return SDL_Color{ grayscale, grayscale, grayscale, 255 };
+    }
+
+    // transform, light, clip and project one triangle into triangles_to_raster,
+    // returns the number of triangles added
+    int process(Triangle& triangle) {
+        // facing and lighting are worked out in object space, the camera and
+        // light were moved there once for the frame
+        Vec3<float> p[3];
+        for (int i = 0; i < 3; i++) {
+            p[i] = Vec3<float>{ (float)triangle.p[i].x, (float)triangle.p[i].y, (float)triangle.p[i].z };
+        }
+        Vec3<float> normal = normalize(cross(p[1] - p[0], p[2] - p[0]));
+        // skip triangles facing away from the camera
+        if (dot(normal, p[0] - this->eye) >= 0)
+            return 0;
+
+        // one transform per vertex straight to clip space
+        Vec4<float> clip[3];
+        for (int i = 0; i < 3; i++) {
+            clip[i] = mul(Vec4<float>{ p[i] }, this->mvp);
+        }
+        return emit(clip, shade_of(normal));
+    }
+
+    // the same for triangle i of packed cluster c or its coarse level, from the
+    // 16 bit positions. With cached, vertices are kept in packed_clip for the
+    // rest of the cluster, which process_cluster set up
+    int process_packed(size_t c, size_t i, bool coarse, bool cached) {
+        PackedCluster& pc = this->packed.clusters[c];
+        PackedTransform& t = this->packed_transforms[c];
+        uint32_t index[3];
+        this->packed.triangle(c, i, coarse, index);
+        PackedVertex *v[3];
+        for (int k = 0; k < 3; k++) {
+            v[k] = &this->packed.vertices[pc.first_vertex + index[k]];
+        }
+
+        // the face normal of the quantized positions is exact in integers
+        int64_t e1[3] = { v[1]->x - v[0]->x, v[1]->y - v[0]->y, v[1]->z - v[0]->z };
+        int64_t e2[3] = { v[2]->x - v[0]->x, v[2]->y - v[0]->y, v[2]->z - v[0]->z };
+        Vec3<float> n = Vec3<float>{
+            (float)(e1[1] * e2[2] - e1[2] * e2[1]),
+            (float)(e1[2] * e2[0] - e1[0] * e2[2]),
+            (float)(e1[0] * e2[1] - e1[1] * e2[0]),
+        };
+        Vec3<float> q0 = Vec3<float>{ (float)v[0]->x, (float)v[0]->y, (float)v[0]->z };
+        if (t.volume * dot(n, q0) + dot(n, t.eye_offset) >= 0)
+            return 0;
+        Vec3<float> normal = normalize(Vec3<float>{ n.x * t.normal_scale.x, n.y * t.normal_scale.y, n.z * t.normal_scale.z });
+
+        Vec4<float> clip[3];
+        for (int k = 0; k < 3; k++) {
+            if (cached && this->packed_done[index[k]]) {
+                clip[k] = this->packed_clip[index[k]];
+                continue;
+            }
+            clip[k] = mul(Vec4<float>{ (float)v[k]->x, (float)v[k]->y, (float)v[k]->z }, t.mvp);
+            if (cached) {
+                this->packed_clip[index[k]] = clip[k];
+                this->packed_done[index[k]] = 1;
+            }
+        }
+        return emit(clip, shade_of(normal));
+    }
+
+    // clip a transformed triangle against the near plane, project it and add
+    // what can produce a pixel to triangles_to_raster, returns how many
+    int emit(const Vec4<float> clip[3], SDL_Color shade) {
+        // clip against the near plane, w is the view space depth
+        Vec4<float> poly[4];
+        int n = 0;
+        float near = (float)this->near;
+        for (int i = 0; i < 3; i++) {
+            const Vec4<float>& a = clip[i];
+            const Vec4<float>& b = clip[(i + 1) % 3];
+            if (a.w >= near)
+                poly[n++] = a;
+            if ((a.w >= near) != (b.w >= near))
+                poly[n++] = a + (b - a) * ((near - a.w) / (b.w - a.w));
+        }
+        if (n < 3)
+            return 0;
+
+        // perspective divide and scale to the screen, snapped to the subpixel grid
+        for (int i = 0; i < n; i++) {
+            float inv_w = 1.0f / poly[i].w;
+            poly[i].x = snap((poly[i].x * inv_w + 1) * 0.5f * this->screen_width);
+            poly[i].y = snap((poly[i].y * inv_w + 1) * 0.5f * this->screen_height);
+            poly[i].z *= inv_w;
+        }
+
+        // fan the 3 or 4 sided result into triangles, dropping the ones that
+        // can't produce a pixel before they cost a clip, sort and draw
+        int added = 0;
+        for (int i = 1; i + 1 < n; i++) {
+            Coverage covers = coverage(poly[0], poly[i], poly[i + 1]);
+            if (covers == COVERAGE_DEGENERATE) {
+                this->stats.triangles_degenerate += 1;
+                continue;
+            }
+            if (covers == COVERAGE_MISSES) {
+                this->stats.triangles_missed += 1;
+                continue;
+            }
+            Triangle tri_projected = Triangle{
+                Vec{ poly[0].x, poly[0].y, poly[0].z },
+                Vec{ poly[i].x, poly[i].y, poly[i].z },
+                Vec{ poly[i + 1].x, poly[i + 1].y, poly[i + 1].z },
+            };
+            tri_projected.shade = shade;
+            tri_projected.distance = (tri_projected.p[0].z + tri_projected.p[1].z + tri_projected.p[2].z) / 3;
+            // store triangle for sorting, draw tris back to front
+            this->triangles_to_raster.push_back(tri_projected);
+            added += 1;
+        }
+        return added;
+    }
+
+    // process triangle i of cluster c or of its coarse level, from the packed
+    // mesh if it's in use, and tag what it adds with the triangle it came from
+    int process_source(size_t c, size_t i, bool coarse, bool cached = false) {
+        Cluster& cluster = this->mesh.clusters[c];
+        size_t first = this->triangles_to_raster.size();
+        int added;
+        if (this->use_packed) {
+            added = process_packed(c, i, coarse, cached);
+        }
+        else {
+            added = process(coarse ? this->mesh.lod_triangles[cluster.lod_first + i] : this->mesh.triangles[cluster.first + i]);
+        }
+        // coarse triangles are numbered after the full mesh's
+        uint32_t source = (uint32_t)(coarse ? this->mesh.triangles.size() + cluster.lod_first + i : cluster.first + i);
+        for (size_t j = first; j < this->triangles_to_raster.size(); j++) {
+            this->triangles_to_raster[j].source = source;
+        }
+        return added;
+    }
+
+    int process_cluster(Cluster& cluster) {
+        int added = 0;
+        bool coarse = use_coarse(cluster);
+        if (coarse)
+            this->stats.clusters_coarse += 1;
+        size_t c = &cluster - this->mesh.clusters.data();
+        size_t count = coarse ? cluster.lod_count : cluster.count;
+
+        // packed vertices are transformed once each, the first time a triangle
+        // facing the camera uses them
+        if (this->use_packed) {
+            this->packed_clip.resize(this->packed.clusters[c].vertex_count);
+            this->packed_done.assign(this->packed.clusters[c].vertex_count, 0);
+        }
+        for (size_t i = 0; i < count; i++) {
+            added += process_source(c, i, coarse, this->use_packed);
+        }
+        return added;
+    }
+
+    // project the corners of a cluster's bounds to the screen, false if any of them
+    // are behind the near plane and the bounds can't be trusted
+    bool screen_bounds(Cluster& cluster, double bounds[4], double *zmin) {
+        bounds[0] = bounds[1] = INFINITY;
+        bounds[2] = bounds[3] = -INFINITY;
+        *zmin = INFINITY;
+        for (int i = 0; i < 8; i++) {
+            Vec corner = Vec{
+                (i & 1) ? cluster.bmax.x : cluster.bmin.x,
+                (i & 2) ? cluster.bmax.y : cluster.bmin.y,
+                (i & 4) ? cluster.bmax.z : cluster.bmin.z,
+            };
+            Vec4<float> clip = mul(Vec4<float>{ (float)corner.x, (float)corner.y, (float)corner.z }, this->mvp);
+            if (clip.w < this->near)
+                return false;
+            Vec projected = project(clip);
+            bounds[0] = std::min(bounds[0], projected.x);
+            bounds[1] = std::min(bounds[1], projected.y);
+            bounds[2] = std::max(bounds[2], projected.x);
+            bounds[3] = std::max(bounds[3], projected.y);
+            *zmin = std::min(*zmin, projected.z);
+        }
+        return true;
+    }
+
+    // drop clusters whose sphere is outside the frustum or whose triangles all face
+    // away, the cone test is the conservative one for any point in the sphere
+    bool cull_cluster(Cluster& cluster) {
+        for (Vec4<float>& plane : this->frustum) {
+            if (dot(plane.xyz(), cluster.center) + plane.w < -cluster.radius) {
+                this->stats.clusters_frustum += 1;
+                this->stats.triangles_culled += cluster.count;
+                return true;
+            }
+        }
+        Vec3<float> to_center = cluster.center - this->eye;
+        if (dot(to_center, cluster.cone_axis) >= cluster.cone_cutoff * std::sqrt(dot(to_center, to_center)) + cluster.radius) {
+            this->stats.clusters_backface += 1;
+            this->stats.triangles_culled += cluster.count;
+            return true;
+        }
+        return false;
+    }
+
+    // pixels the coarse level of a cluster can be off by, its model space
+    // error scaled at the depth of the bounding sphere's nearest point
+    double coarse_error(Cluster& cluster) {
+        float depth = mul(Vec4<float>{ cluster.center }, this->mvp).w - cluster.radius;
+        if (depth < this->near)
+            return INFINITY;
+        return cluster.lod_error * this->proj_matrix.m[1][1] * 0.5 * this->screen_height / depth;
+    }
+
+    // clusters whose coarse level is off by less than the governor's lod error draw it
+    bool use_coarse(Cluster& cluster) {
+        return this->governor.lod_error > 0 && cluster.lod_count > 0 && coarse_error(cluster) < this->governor.lod_error;
+    }
+
+    bool occluded(Cluster& cluster) {
+        double bounds[4];
+        double zmin;
+        return screen_bounds(cluster, bounds, &zmin)
+            && this->hiz.occluded(bounds[0], bounds[1], bounds[2], bounds[3], zmin);
+    }
+
+    // model-view-projection for this frame and the camera and light in
+    // object space, updates look_dir
+    void matrices() {
+        // set up camera looking vectors
+        Vec target_vec = Vec{ 0, 0, 1 };
+        Matrix rotcamera_matrix = Matrix::rotate_y(this->yaw);
+        this->look_dir = Vec::matmul(target_vec, rotcamera_matrix);
+        target_vec = Vec::add(this->camera, this->look_dir);
+
+        Matrix camera_matrix = Matrix::point_at(this->camera, target_vec, this->up_vec);
+        Matrix view_matrix = Matrix::quick_inverse(camera_matrix);
+
+        // concatenated once so each vertex takes a single transform
+        Mat4<float> world_view = mul(to_mat4<float>(this->world_matrix), to_mat4<float>(view_matrix));
+        this->mvp = mul(world_view, to_mat4<float>(this->proj_matrix));
+
+        // frustum planes from the columns of the combined matrix, left, right,
+        // bottom, top, near and far, normalized for sphere distances
+        Vec4<float> column[4];
+        for (int j = 0; j < 4; j++) {
+            column[j] = Vec4<float>{ this->mvp.m[0][j], this->mvp.m[1][j], this->mvp.m[2][j], this->mvp.m[3][j] };
+        }
+        this->frustum[0] = column[3] + column[0];
+        this->frustum[1] = column[3] - column[0];
+        this->frustum[2] = column[3] + column[1];
+        this->frustum[3] = column[3] - column[1];
+        this->frustum[4] = column[3] - Vec4<float>{ 0, 0, 0, (float)this->near };
+        this->frustum[5] = column[3] - column[2];
+        for (Vec4<float>& plane : this->frustum) {
+            float length = std::sqrt(dot(plane.xyz(), plane.xyz()));
+            plane = plane * (1.0f / length);
+        }
+
+        // world is rigid, so its quick inverse takes the camera and light back to the mesh
+        Matrix object_matrix = Matrix::quick_inverse(this->world_matrix);
+        Vec eye = Vec::matmul(this->camera, object_matrix);
+        Vec light = Vec{ 1, 1, -1, 0 };
+        light = Vec::matmul(light, object_matrix);
+        this->eye = Vec3<float>{ (float)eye.x, (float)eye.y, (float)eye.z };
+        this->light = normalize(Vec3<float>{ (float)light.x, (float)light.y, (float)light.z });
+    }
+
+    void geometry() {
+        PROF_ZONE("geometry");
+        this->triangles_to_raster.clear();
+
+        matrices();
+        this->stats.triangles_degenerate = 0;
+        this->stats.triangles_missed = 0;
+        if (this->use_packed) {
+            this->packed_transforms.resize(this->packed.clusters.size());
+            for (size_t c = 0; c < this->packed.clusters.size(); c++) {
+                this->packed_transforms[c] = this->packed.transform(c, this->mvp, this->eye);
+            }
+        }
+
+        if (temporal_valid()) {
+            // the camera barely moved since the last full pass, redraw what was visible
+            // then in the order it was sorted into instead of culling and sorting again
+            for (uint32_t source : this->temporal_order) {
+                bool coarse = source >= this->mesh.triangles.size();
+                size_t index = coarse ? source - this->mesh.triangles.size() : source;
+                auto next = std::upper_bound(this->mesh.clusters.begin(), this->mesh.clusters.end(), index,
+                    [coarse](size_t s, Cluster& cluster) { return s < (coarse ? cluster.lod_first : cluster.first); });
+                size_t c = (next - this->mesh.clusters.begin()) - 1;
+                process_source(c, index - (coarse ? this->mesh.clusters[c].lod_first : this->mesh.clusters[c].first), coarse);
+            }
+            this->temporal_age += 1;
+            this->stats.frames_temporal += 1;
+            return;
+        }
+
+        this->stats.clusters = this->mesh.clusters.size();
+        this->stats.clusters_occluded = 0;
+        this->stats.triangles_occluded = 0;
+        this->stats.clusters_coarse = 0;
+        this->stats.clusters_frustum = 0;
+        this->stats.clusters_backface = 0;
+        this->stats.triangles_culled = 0;
+
+        // culled clusters are skipped by every pass below and can't be occluders
+        for (Cluster& cluster : this->mesh.clusters) {
+            cluster.culled = cull_cluster(cluster);
+            if (cluster.culled)
+                cluster.visible = false;
+        }
+
+        if (!this->use_hiz) {
+            for (Cluster& cluster : this->mesh.clusters) {
+                if (cluster.culled)
+                    continue;
+                process_cluster(cluster);
+                cluster.visible = true;
+            }
+        }
+        else {
+            // clusters drawn last frame are the occluders, draw them first
+            // and rasterize what they produced into the depth pyramid
+            this->hiz.clear();
+            for (Cluster& cluster : this->mesh.clusters) {
+                if (cluster.visible)
+                    process_cluster(cluster);
+            }
+            for (Triangle& t : this->triangles_to_raster) {
+                this->hiz.rasterize(t);
+            }
+            this->hiz.build();
+
+            // then test everything that was hidden last frame against them
+            size_t first = this->triangles_to_raster.size();
+            for (Cluster& cluster : this->mesh.clusters) {
+                if (cluster.visible || cluster.culled)
+                    continue;
+                if (occluded(cluster)) {
+                    this->stats.clusters_occluded += 1;
+                    this->stats.triangles_occluded += cluster.count;
+                    continue;
+                }
+                process_cluster(cluster);
+                cluster.visible = true;
+            }
+
+            // with the full frame in the pyramid, drop occluders that are now hidden
+            // themselves so they get tested next frame instead of drawn blindly
+            for (size_t i = first; i < this->triangles_to_raster.size(); i++) {
+                this->hiz.rasterize(this->triangles_to_raster[i]);
+            }
+            this->hiz.build();
+            for (Cluster& cluster : this->mesh.clusters) {
+                if (cluster.visible)
+                    cluster.visible = !occluded(cluster);
+            }
+        }
+
+        std::sort(this->triangles_to_raster.rbegin(), this->triangles_to_raster.rend(), [](Triangle& t1, Triangle& t2) {
+            // distance defaults to 0 but it should be set, if this fails, then something else is wrong!
+            return t1.distance < t2.distance;
+        });
+
+        // remember the sorted visible set, clipping can split a triangle into several
+        this->temporal_order.clear();
+        this->temporal_seen.assign(this->mesh.triangles.size() + this->mesh.lod_triangles.size(), 0);
+        for (Triangle& t : this->triangles_to_raster) {
+            if (!this->temporal_seen[t.source]) {
+                this->temporal_seen[t.source] = 1;
+                this->temporal_order.push_back(t.source);
+            }
+        }
+        this->temporal_camera = this->camera;
+        this->temporal_yaw = this->yaw;
+        this->temporal_state = frame_state();
+        this->temporal_age = 0;
+    }
+
+    FrameState frame_state() {
+        FrameState state;
+        state.flags = (uint32_t)this->use_hiz | (uint32_t)this->use_packed << 1 | (uint32_t)this->use_edges << 2
+            | (uint32_t)this->use_fill << 3 | (uint32_t)this->use_temporal << 4;
+        state.width = this->screen_width;
+        state.height = this->screen_height;
+        state.lod_error = this->governor.lod_error;
+        return state;
+    }
+
+    // true if the last full pass's visible set can stand in for culling this frame
+    bool temporal_valid() {
+        if (!this->use_temporal || this->temporal_state != frame_state() || this->temporal_age >= TEMPORAL_MAX_AGE)
+            return false;
+        return Vec::dist(this->camera, this->temporal_camera) < TEMPORAL_MOVE && std::abs(this->yaw - this->temporal_yaw) < TEMPORAL_TURN;
+    }
+
+    // screen position of a clip space point in front of the near plane, z / w in z
+    Vec project(const Vec4<float>& clip) {
+        double inv_w = 1.0 / clip.w;
+        return Vec{
+            (clip.x * inv_w + 1) * 0.5 * this->screen_width,
+            (clip.y * inv_w + 1) * 0.5 * this->screen_height,
+            clip.z * inv_w,
+        };
+    }
+
+    // draw each mesh edge once, skipping edges with no face toward the camera,
+    // straight into the framebuffer
+    void wireframe() {
+        matrices();
+
+        // every vertex is transformed once, shared by all the edges that use it
+        static std::vector<Vec4<float>> clip;
+        static std::vector<Vec> screen;
+        size_t vertex_count = this->mesh.vertices.size();
+        clip.resize(vertex_count);
+        screen.resize(vertex_count);
+        for (size_t i = 0; i < vertex_count; i++) {
+            Vec& v = this->mesh.vertices[i];
+            clip[i] = mul(Vec4<float>{ (float)v.x, (float)v.y, (float)v.z }, this->mvp);
+            if (clip[i].w >= this->near)
+                screen[i] = project(clip[i]);
+        }
+
+        // facing and shade of every face, in object space
+        static std::vector<char> front;
+        static std::vector<uint32_t> shade;
+        size_t face_count = this->mesh.indices.size() / 3;
+        front.resize(face_count);
+        shade.resize(face_count);
+        for (size_t f = 0; f < face_count; f++) {
+            Vec& v0 = this->mesh.vertices[this->mesh.indices[f * 3]];
+            Vec& v1 = this->mesh.vertices[this->mesh.indices[f * 3 + 1]];
+            Vec& v2 = this->mesh.vertices[this->mesh.indices[f * 3 + 2]];
+            Vec3<float> p0 = Vec3<float>{ (float)v0.x, (float)v0.y, (float)v0.z };
+            Vec3<float> p1 = Vec3<float>{ (float)v1.x, (float)v1.y, (float)v1.z };
+            Vec3<float> p2 = Vec3<float>{ (float)v2.x, (float)v2.y, (float)v2.z };
+            Vec3<float> normal = normalize(cross(p1 - p0, p2 - p0));
+            front[f] = dot(normal, p0 - this->eye) < 0;
+
+            unsigned char grayscale = (unsigned char)std::abs(255 * std::max(0.1f, dot(this->light, normal)));
+            shade[f] = pack_color(SDL_Color{ grayscale, grayscale, grayscale, 255 });
+        }
+
+        this->lines.clear();
+        size_t edge_count = this->edges.v0.size();
+        for (size_t e = 0; e < edge_count; e++) {
+            uint32_t f0 = this->edges.f0[e];
+            uint32_t f1 = this->edges.f1[e];
+            bool front0 = front[f0];
+            bool front1 = f1 != NO_FACE && front[f1];
+            if (!front0 && !front1)
+                continue;
+            uint32_t color = front0 && front1 ? std::max(shade[f0], shade[f1]) : (front0 ? shade[f0] : shade[f1]);
+
+            uint32_t a = this->edges.v0[e];
+            uint32_t b = this->edges.v1[e];
+            bool in_a = clip[a].w >= this->near;
+            bool in_b = clip[b].w >= this->near;
+            if (in_a && in_b) {
+                this->lines.push(screen[a].x, screen[a].y, screen[b].x, screen[b].y, color);
+            }
+            else if (in_a || in_b) {
+                // cut the edge at the near plane
+                Vec4<float>& inside = in_a ? clip[a] : clip[b];
+                Vec4<float>& outside = in_a ? clip[b] : clip[a];
+                float t = ((float)this->near - inside.w) / (outside.w - inside.w);
+                Vec4<float> cut = inside + (outside - inside) * t;
+                Vec s0 = project(inside);
+                Vec s1 = project(cut);
+                this->lines.push(s0.x, s0.y, s1.x, s1.y, color);
+            }
+        }
+
+        this->framebuffer.resize(this->screen_width, this->screen_height);
+        this->framebuffer.clear(pack_color(SDL_Color{ 0, 0, 0, 255 }));
+        draw_lines(this->framebuffer, this->lines);
+
+        this->stats.edges = edge_count;
+        this->stats.edges_drawn = this->lines.size();
+    }
+
+    // current render resolution relative to the display
+    double render_scale() {
+        return this->governor.scale;
+    }
+
+    void set_frame_target(double ms) {
+        this->governor.target_ms = ms;
+    }
+
+    // resize the render targets to the governor's scale, the framebuffer
+    // is stretched back to the display when presented
+    void apply_governor() {
+        int width = std::max(1, (int)(this->display_width * this->governor.scale + 0.5));
+        int height = std::max(1, (int)(this->display_height * this->governor.scale + 0.5));
+        if (width == this->screen_width && height == this->screen_height)
+            return;
+        this->screen_width = width;
+        this->screen_height = height;
+        this->hiz.resize(width, height);
+    }
+
+    // run the geometry stage into a frame, on either thread
+    void make_frame(Frame& frame) {
+        PROF_COUNTERS("trace geometry");
+        auto t0 = std::chrono::steady_clock::now();
+        geometry();
+        auto t1 = std::chrono::steady_clock::now();
+        frame.triangles.swap(this->triangles_to_raster);
+        frame.width = this->screen_width;
+        frame.height = this->screen_height;
+        frame.geometry_ms = std::chrono::duration<double, std::milli>(t1 - t0).count();
+        frame.ready = true;
+    }
+
+    // raster a frame into the back buffer, on either thread
+    void draw_frame(Frame& frame) {
+        PROF_COUNTERS("trace raster");
+        auto t0 = std::chrono::steady_clock::now();
+        raster(frame);
+        auto t1 = std::chrono::steady_clock::now();
+        frame.ready = false;
+        this->drawn = true;
+        this->drawn_latched = frame.latched;
+
+        this->stats.triangles_raster = frame.triangles.size();
+        this->stats.geometry_ms = frame.geometry_ms;
+        this->stats.raster_ms = std::chrono::duration<double, std::milli>(t1 - t0).count();
+    }
+
+    // swap in the frame drawn last and upload it, on the render thread with nothing drawing
+    void show() {
+        auto t0 = std::chrono::steady_clock::now();
+        this->framebuffer.swap();
+        this->framebuffer.present();
+        auto t1 = std::chrono::steady_clock::now();
+        this->drawn = false;
+        this->stats.present_ms = std::chrono::duration<double, std::milli>(t1 - t0).count();
+        this->stats.latency_ms = std::chrono::duration<double, std::milli>(t1 - this->drawn_latched).count();
+    }
+
+    void update() {
+        PROF_ZONE("Graphics::update");
+        // everything the workers read, the camera, toggles, render size and
+        // the framebuffer's back buffer, only changes while they're idle, so
+        // each frame sees a latched copy
+        this->geometry_worker.wait();
+        this->raster_worker.wait();
+        if (this->use_governor && this->governor_ms > 0) {
+            this->governor.update(this->governor_ms);
+            apply_governor();
+        }
+        this->governor_ms = 0;
+        this->stats.render_scale = this->governor.scale;
+        this->stats.lod_error = this->governor.lod_error;
+        input();
+
+        // made by geometry and waiting for raster
+        Frame *made = this->frames[0].ready ? &this->frames[0] : (this->frames[1].ready ? &this->frames[1] : nullptr);
+        Frame& next = made == &this->frames[0] ? this->frames[1] : this->frames[0];
+
+        // nothing moved or changed, the last frame is still correct
+        bool still = this->camera.x == this->last_camera.x && this->camera.y == this->last_camera.y
+            && this->camera.z == this->last_camera.z && this->yaw == this->last_yaw;
+        bool changed = !still || this->last_state != frame_state() || !this->use_temporal;
+        if (!changed && !made && !this->drawn) {
+            this->framebuffer.present_again();
+            this->stats.frames_reused += 1;
+            return;
+        }
+        this->last_camera = this->camera;
+        this->last_yaw = this->yaw;
+        this->last_state = frame_state();
+
+        double frame_ms;
+        if (this->use_edges) {
+            this->frames[0].ready = this->frames[1].ready = false;
+            auto t0 = std::chrono::steady_clock::now();
+            wireframe();
+            auto t1 = std::chrono::steady_clock::now();
+            this->drawn_latched = t0;
+            show();
+            this->stats.raster_ms = std::chrono::duration<double, std::milli>(t1 - t0).count();
+            this->stats.geometry_ms = 0;
+            this->stats.latency_frames = 0;
+            frame_ms = this->stats.raster_ms + this->stats.present_ms;
+        }
+        else if (!this->use_pipeline) {
+            if (made)
+                made->ready = false;
+            this->frames[0].latched = std::chrono::steady_clock::now();
+            make_frame(this->frames[0]);
+            draw_frame(this->frames[0]);
+            show();
+            this->stats.latency_frames = 0;
+            frame_ms = this->stats.geometry_ms + this->stats.raster_ms + this->stats.present_ms;
+        }
+        else {
+            // the frame drawn last update is uploaded here while the one made
+            // last update rasters into the other buffer and the next is made,
+            // the screen shows the camera from two updates ago. What the
+            // workers write is read before they start
+            bool shown = this->drawn;
+            auto shown_latched = this->drawn_latched;
+            double geometry_ms = this->stats.geometry_ms;
+            double raster_ms = this->stats.raster_ms;
+            if (shown) {
+                this->framebuffer.swap();
+                this->drawn = false;
+            }
+            if (made)
+                this->raster_worker.submit([this, made]() { draw_frame(*made); });
+            if (changed) {
+                next.latched = std::chrono::steady_clock::now();
+                this->geometry_worker.submit([this, &next]() { make_frame(next); });
+            }
+            if (shown) {
+                auto t0 = std::chrono::steady_clock::now();
+                this->framebuffer.present();
+                auto t1 = std::chrono::steady_clock::now();
+                this->stats.present_ms = std::chrono::duration<double, std::milli>(t1 - t0).count();
+                this->stats.latency_ms = std::chrono::duration<double, std::milli>(t1 - shown_latched).count();
+                this->stats.latency_frames = 2;
+                frame_ms = std::max({ geometry_ms, raster_ms, this->stats.present_ms });
+            }
+            else if (this->framebuffer.presented()) {
+                // pipeline is filling, the last frame stays on screen until the next one is drawn
+                this->framebuffer.present_again();
+                return;
+            }
+            else {
+                // nothing to show yet, the first frame, wait for this one and draw it here
+                this->geometry_worker.wait();
+                draw_frame(next);
+                show();
+                this->stats.latency_frames = 0;
+                frame_ms = this->stats.geometry_ms + this->stats.raster_ms + this->stats.present_ms;
+            }
+        }
+
+        // the governor's changes are read by the geometry stage, they're applied next update
+        this->governor_ms = frame_ms;
+    }
+};
+
+} // trace
+
+namespace Modules {
+
+void trace_setup(pse::Context& ctx)
+{
+    trace::Ctx = &ctx;
+    prof::zone_thread_name("main");
+    // refuse to start if the SSE products or the fused MVP disagree with the scalar ones
+    if (const char *check = getenv("TRACE_CHECK_MATH")) {
+        if (trace::math_check(std::max(1, atoi(check)), 0) > 0) {
+            fprintf(stderr, "Error: Float and scalar products disagree\n");
+            exit(-1);
+        }
+        trace::math_bench(trace::MATH_BENCH_VERTICES, trace::MATH_BENCH_ROUNDS);
+    }
+}
+
+void trace_update(pse::Context& ctx)
+{
+    PROF_MODULE("trace");
+    PROF_ZONE("trace_update");
+    static trace::Graphics graphics = trace::Graphics{ "src/modules/trace_assets/mountains.obj", ctx.screen_height, ctx.screen_width };
+    graphics.update();
+}
+
+}
\ No newline at end of file
@@ -0,0 +1,574 @@
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "../../pse.hpp"
+#include "globals.hpp"
+#include "math.hpp"
+
+namespace trace {
+
+struct Matrix;
+
+struct Vec {
+    double x = 0;
+    double y = 0;
+    double z = 0;
+    double w = 1;
+
+    Vec() : x(0), y(0), z(0), w(1) {}
+    Vec(double x, double y, double z): x(x), y(y), z(z), w(1) {}
+    Vec(double x, double y, double z, double w) : x(x), y(y), z(z), w(w) {}
+
+    static Vec add(Vec& v1, Vec& v2) {
+        return Vec{ v1.x + v2.x, v1.y + v2.y, v1.z + v2.z, v1.w + v2.w };
+    }
+
+    static Vec sub(Vec& v1, Vec& v2) {
+        return Vec{ v1.x - v2.x, v1.y - v2.y, v1.z - v2.z, v1.w - v2.w };
+    }
+
+    static Vec mul(Vec& v, double k) {
+        return Vec{ v.x * k, v.y * k, v.z * k, v.w * k };
+    }
+    
+    static Vec div(Vec& v, double k) {
+        return Vec{ v.x / k, v.y / k, v.z / k, v.w / k };
+    }
+
+    static double dot(Vec& v1, Vec& v2) {
+        return v1.x* v2.x + v1.y * v2.y + v1.z * v2.z;
+    }
+
+    static Vec cross(Vec& v1, Vec& v2) {
+        return Vec{
+            v1.y * v2.z - v1.z * v2.y,
+            v1.z * v2.x - v1.x * v2.z,
+            v1.x * v2.y - v1.y * v2.x,
+        };
+    }
+
+    static double mag(Vec& v) {
+        return (double)fast_sqrtf((float)Vec::dot(v, v));
+    }
+
+    static Vec normal(Vec& v) {
+        double m = Vec::mag(v);
+        return Vec{ v.x / m, v.y / m, v.z / m, v.w / m};
+    }
+
+    // 1x4 * 4x4 -> 1x4
+    static Vec matmul(Vec& v, Matrix& m);
+
+    static double dist(Vec& v1, Vec& v2) {
+        return (double)fast_sqrtf((float)((v2.x - v1.x) * (v2.x - v1.x) + (v2.y - v1.y) * (v2.y - v1.y) + (v2.z - v1.z) * (v2.z - v1.z)));
+    }
+
+    static double dist_from_plane(Vec& p, Vec& plane_n, Vec& plane_p) {
+        return (plane_n.x * p.x + plane_n.y * p.y + plane_n.z * p.z - Vec::dot(plane_n, plane_p));
+    }
+
+    static Vec intersect_plane(Vec& plane_p, Vec& plane_n, Vec& line_start, Vec& line_end) {
+        // detect a vector intersecting a plane
+        plane_n = Vec::normal(plane_n);
+        double plane_d = -1.0 * Vec::dot(plane_n, plane_p);
+        double ad = Vec::dot(line_start, plane_n);
+        double bd = Vec::dot(line_end, plane_n);
+        double t = (-1.0 * plane_d - ad) / (bd - ad);
+        Vec line_start_to_end = Vec::sub(line_end, line_start);
+        Vec line_to_intersect = Vec::mul(line_start_to_end, t);
+        return Vec::add(line_start, line_to_intersect);
+    }
+};
+
+struct Matrix {
+    double m[4][4] = { 0 };
+
+    Matrix() {}
+    Matrix(int _) : m{ {1, 0, 0, 0}, {0, 1, 0, 0}, {0, 0, 1, 0}, {0, 0, 0, 1} } {}
+    Matrix(
+        double _00, double _01, double _02, double _03,
+        double _10, double _11, double _12, double _13,
+        double _20, double _21, double _22, double _23,
+        double _30, double _31, double _32, double _33
+    ) : m{
+        {_00, _01, _02, _03},
+        {_10, _11, _12, _13},
+        {_20, _21, _22, _23},
+        {_30, _31, _32, _33}
+    } {}
+
+    static Matrix rotate_x(double radians) {
+        Matrix m = Matrix{};
+        m.m[0][0] = 1.0;
+        m.m[1][1] = fast_cos(radians);
+        m.m[1][2] = fast_sin(radians);
+        m.m[2][1] = -1.0 * fast_sin(radians);
+        m.m[2][2] = fast_cos(radians);
+        m.m[3][3] = 1.0;
+        return m;
+    }
+
+    static Matrix rotate_y(double radians) {
+        Matrix m = Matrix{};
+        m.m[0][0] = fast_cos(radians);
+        m.m[0][2] = fast_sin(radians);
+        m.m[2][0] = -1 * fast_sin(radians);
+        m.m[1][1] = 1.0;
+        m.m[2][2] = fast_cos(radians);
+        m.m[3][3] = 1.0;
+        return m;
+    }
+
+    static Matrix rotate_z(double radians) {
+        Matrix m = Matrix{};
+        m.m[0][0] = fast_cos(radians);
+        m.m[0][1] = fast_sin(radians);
+        m.m[1][0] = -1 * fast_sin(radians);
+        m.m[1][1] = fast_cos(radians);
+        m.m[2][2] = 1.0;
+        m.m[3][3] = 1.0;
+        return m;
+    }
+
+    static Matrix translate(double x, double y, double z) {
+        Matrix m = Matrix{0};
+        m.m[3][0] = x;
+        m.m[3][1] = y;
+        m.m[3][2] = z;
+        return m;
+    }
+
+    static Matrix project(double fov, double aspect_ratio, double near, double far) {
+        double fov_rad = 1.0 / tan(fov * 0.5 * M_PI / 180);
+        Matrix m = Matrix{};
+        m.m[0][0] = aspect_ratio * fov_rad;
+        m.m[1][1] = fov_rad;
+        m.m[2][2] = far / (far - near);
+        m.m[3][2] = (-1.0 * far * near) / (far - near);
+        m.m[2][3] = 1.0;
+        m.m[3][3] = 0.0;
+        return m;
+    }
+
+    static Matrix point_at(Vec& pos, Vec& target, Vec& up) {
+        // find where the new forward is
+        Vec new_forward = Vec::sub(target, pos);
+        new_forward = Vec::normal(new_forward);
+
+        // find new up direction
+        Vec new_up = Vec::mul(new_forward, Vec::dot(up, new_forward));
+        new_up = Vec::sub(up, new_up);
+        new_up = Vec::normal(new_up);
+
+        // new right direction
+        Vec new_right = Vec::cross(new_up, new_forward);
+
+        return Matrix{
+            new_right.x,   new_right.y,   new_right.z,   0.0,
+            new_up.x,      new_up.y,      new_up.z,      0.0,
+            new_forward.x, new_forward.y, new_forward.z, 0.0,
+            pos.x,         pos.y,         pos.z,         1.0,
+        };
+    }
+
+    static Matrix quick_inverse(Matrix& m) {
+        return Matrix{
+            m.m[0][0], m.m[1][0], m.m[2][0], 0,
+            m.m[0][1], m.m[1][1], m.m[2][1], 0,
+            m.m[0][2], m.m[1][2], m.m[2][2], 0,
+            -1.0 * (m.m[3][0] * m.m[0][0] + m.m[3][1] * m.m[1][0] + m.m[3][2] * m.m[2][0]),
+            -1.0 * (m.m[3][0] * m.m[0][1] + m.m[3][1] * m.m[1][1] + m.m[3][2] * m.m[2][1]),
+            -1.0 * (m.m[3][0] * m.m[0][2] + m.m[3][1] * m.m[1][2] + m.m[3][2] * m.m[2][2]),
+             1.0
+        };
+    }
+
+    /*
+    00 01 02 03   00 01 02 03   00*00 + 10*01 + 20*02 + 30*03
+    10 11 12 13   10 11 12 13   
+    20 21 22 23   20 21 22 23   
+    30 31 32 33   30 31 32 33   
+    */
+
+    static Matrix matmul(Matrix& m1, Matrix& m2) {
+        return Matrix{
+            m1.m[0][0]*m2.m[0][0] + m1.m[0][1]*m2.m[1][0] + m1.m[0][2]*m2.m[2][0] + m1.m[0][3]*m2.m[3][0],
+            m1.m[0][0]*m2.m[0][1] + m1.m[0][1]*m2.m[1][1] + m1.m[0][2]*m2.m[2][1] + m1.m[0][3]*m2.m[3][1],
+            m1.m[0][0]*m2.m[0][2] + m1.m[0][1]*m2.m[1][2] + m1.m[0][2]*m2.m[2][2] + m1.m[0][3]*m2.m[3][2],
+            m1.m[0][0]*m2.m[0][3] + m1.m[0][1]*m2.m[1][3] + m1.m[0][2]*m2.m[2][3] + m1.m[0][3]*m2.m[3][3],
+            
+            m1.m[1][0]*m2.m[0][0] + m1.m[1][1]*m2.m[1][0] + m1.m[1][2]*m2.m[2][0] + m1.m[1][3]*m2.m[3][0],
+            m1.m[1][0]*m2.m[0][1] + m1.m[1][1]*m2.m[1][1] + m1.m[1][2]*m2.m[2][1] + m1.m[1][3]*m2.m[3][1],
+            m1.m[1][0]*m2.m[0][2] + m1.m[1][1]*m2.m[1][2] + m1.m[1][2]*m2.m[2][2] + m1.m[1][3]*m2.m[3][2],
+            m1.m[1][0]*m2.m[0][3] + m1.m[1][1]*m2.m[1][3] + m1.m[1][2]*m2.m[2][3] + m1.m[1][3]*m2.m[3][3],
+            
+            m1.m[2][0]*m2.m[0][0] + m1.m[2][1]*m2.m[1][0] + m1.m[2][2]*m2.m[2][0] + m1.m[2][3]*m2.m[3][0],
+            m1.m[2][0]*m2.m[0][1] + m1.m[2][1]*m2.m[1][1] + m1.m[2][2]*m2.m[2][1] + m1.m[2][3]*m2.m[3][1],
+            m1.m[2][0]*m2.m[0][2] + m1.m[2][1]*m2.m[1][2] + m1.m[2][2]*m2.m[2][2] + m1.m[2][3]*m2.m[3][2],
+            m1.m[2][0]*m2.m[0][3] + m1.m[2][1]*m2.m[1][3] + m1.m[2][2]*m2.m[2][3] + m1.m[2][3]*m2.m[3][3],
+            
+            m1.m[3][0]*m2.m[0][0] + m1.m[3][1]*m2.m[1][0] + m1.m[3][2]*m2.m[2][0] + m1.m[3][3]*m2.m[3][0],
+            m1.m[3][0]*m2.m[0][1] + m1.m[3][1]*m2.m[1][1] + m1.m[3][2]*m2.m[2][1] + m1.m[3][3]*m2.m[3][1],
+            m1.m[3][0]*m2.m[0][2] + m1.m[3][1]*m2.m[1][2] + m1.m[3][2]*m2.m[2][2] + m1.m[3][3]*m2.m[3][2],
+            m1.m[3][0]*m2.m[0][3] + m1.m[3][1]*m2.m[1][3] + m1.m[3][2]*m2.m[2][3] + m1.m[3][3]*m2.m[3][3],
+        };
+    }
+};
+
+template <typename T>
+Mat4<T> to_mat4(Matrix& m)
+{
+    Mat4<T> r;
+    for (int i = 0; i < 4; i++) {
+        for (int j = 0; j < 4; j++)
+            r.m[i][j] = (T)m.m[i][j];
+    }
+    return r;
+}
+
+inline Vec Vec::matmul(Vec& v, Matrix& m) {
+    return Vec{
+        v.x * m.m[0][0] + v.y * m.m[1][0] + v.z * m.m[2][0] + v.w * m.m[3][0],
+        v.x * m.m[0][1] + v.y * m.m[1][1] + v.z * m.m[2][1] + v.w * m.m[3][1],
+        v.x * m.m[0][2] + v.y * m.m[1][2] + v.z * m.m[2][2] + v.w * m.m[3][2],
+        v.x * m.m[0][3] + v.y * m.m[1][3] + v.z * m.m[2][3] + v.w * m.m[3][3],
+    };
+}
+
+struct Triangle {
+    Vec p[3];
+    SDL_Color shade = SDL_Color{ 255, 255, 255, 255 };
+    double distance = 0;
+    bool covered = false; // hidden behind closer triangles, not drawn
+    uint32_t source = 0;  // mesh triangle it was produced from, coarse ones count on from the last
+
+    Triangle() : p{ Vec{}, Vec{}, Vec{} }, shade{ 255, 255, 255, 255 }, distance{ 0 } {}
+    Triangle(Vec v1, Vec v2, Vec v3) : p{ v1, v2, v3 }, shade{ 255, 255, 255, 255 }, distance{ 0 } {}
+
+    static int clip_against_plane(Vec& plane_p, Vec& plane_n, Triangle& in_t, Triangle& out_t1, Triangle& out_t2) {
+        int retval = 0;
+
+        // make sure the plane is normal
+        plane_n = Vec::normal(plane_n);
+
+        // classify points either in or out of a plane
+        // distance is positive, then point is inside the plane
+        static std::vector<Vec> inside_points;
+        size_t inside_point_count = 0;
+        static std::vector<Vec> outside_points;
+        size_t outside_point_count = 0;
+
+        // calculate distance from each point in
+        // the triangle to the plane
+        double d0 = Vec::dist_from_plane(in_t.p[0], plane_n, plane_p);
+        double d1 = Vec::dist_from_plane(in_t.p[1], plane_n, plane_p);
+        double d2 = Vec::dist_from_plane(in_t.p[2], plane_n, plane_p);
+
+        if (d0 >= 0.0) {
+            inside_points.push_back(in_t.p[0]);
+            inside_point_count += 1;
+        }
+        else {
+            outside_points.push_back(in_t.p[0]);
+            outside_point_count += 1;
+        }
+        if (d1 >= 0.0) {
+            inside_points.push_back(in_t.p[1]);
+            inside_point_count += 1;
+        }
+        else {
+            outside_points.push_back(in_t.p[1]);
+            outside_point_count += 1;
+        }
+        if (d2 >= 0.0) {
+            inside_points.push_back(in_t.p[2]);
+            inside_point_count += 1;
+        }
+        else {
+            outside_points.push_back(in_t.p[2]);
+            outside_point_count += 1;
+        }
+
+        // classify points
+        if (inside_point_count == 0) {
+            // all points outside of plan, clip the entire triangle
+            retval = 0;
+        }
+
+        // all points inside of plane, let triangle pass through
+        else if (inside_point_count == 3) {
+            out_t1.shade = in_t.shade;
+
+            out_t1.p[0].x = in_t.p[0].x;
+            out_t1.p[0].y = in_t.p[0].y;
+            out_t1.p[0].z = in_t.p[0].z;
+
+            out_t1.p[1].x = in_t.p[1].x;
+            out_t1.p[1].y = in_t.p[1].y;
+            out_t1.p[1].z = in_t.p[1].z;
+
+            out_t1.p[2].x = in_t.p[2].x;
+            out_t1.p[2].y = in_t.p[2].y;
+            out_t1.p[2].z = in_t.p[2].z;
+
+            retval = 1;
+        }
+
+        // triangle should be clipped to smaller triangle, two points outside
+        else if (inside_point_count == 1 && outside_point_count == 2) {
+            out_t1.shade = in_t.shade;
+
+            // inside point is valid
+            out_t1.p[0] = inside_points[0];
+
+            // two other points at the intersection of the plane/triangle
+            out_t1.p[1] = Vec::intersect_plane(plane_p, plane_n, inside_points[0], outside_points[0]);
+            out_t1.p[2] = Vec::intersect_plane(plane_p, plane_n, inside_points[0], outside_points[1]);
+
+            retval = 1;
+        }
+
+        // triangle should be clipped into quad, 1 point outside
+        else if (inside_point_count == 2 && outside_point_count == 1) {
+            out_t1.shade = in_t.shade;
+            out_t2.shade = in_t.shade;
+            
+            // first triangle made of two inside points
+            // and a new point at the intersection
+            out_t1.p[0] = inside_points[0];
+            out_t1.p[1] = inside_points[1];
+            out_t1.p[2] = Vec::intersect_plane(plane_p, plane_n, inside_points[0], outside_points[0]);
+
+            // second triangle made of one inside point,
+            // previously created point, and at intersection
+            out_t2.p[0] = inside_points[1];
+            out_t2.p[1] = out_t1.p[2];
+            out_t2.p[2] = Vec::intersect_plane(plane_p, plane_n, inside_points[1], outside_points[0]);
+
+            retval = 2;
+        }
+
+        inside_points.clear();
+        outside_points.clear();
+
+        return retval;
+    }
+};
+
+// a contiguous range of mesh triangles with model space bounds,
+// visibility is tested per cluster before any triangle is transformed
+struct Cluster {
+    size_t first = 0;
+    size_t count = 0;
+    Vec bmin = Vec{};
+    Vec bmax = Vec{};
+    Vec3<float> center = Vec3<float>{}; // bounding sphere
+    float radius = 0;
+    Vec3<float> cone_axis = Vec3<float>{}; // average facing of the triangles
+    float cone_cutoff = 1;                 // sine of the cone's half angle, 1 never culls
+    // coarse level, lod_triangles[lod_first, lod_first + lod_count), none if lod_count is 0
+    size_t lod_first = 0;
+    size_t lod_count = 0;
+    float lod_error = 0; // furthest any vertex moved to make it, in model space
+    bool visible = true; // drawn last frame, used as an occluder this frame
+    bool culled = false; // outside the frustum or facing away this frame
+};
+
+struct Mesh {
+    std::vector<Triangle> triangles;
+    std::vector<Cluster> clusters;
+    // the *.obj vertex table, triangle i is indices[3i], indices[3i + 1], indices[3i + 2]
+    std::vector<Vec> vertices;
+    std::vector<uint32_t> indices;
+    // every cluster's coarse level, indexed like triangles and indices
+    std::vector<Triangle> lod_triangles;
+    std::vector<uint32_t> lod_indices;
+
+    Mesh() {}
+
+    // sort triangles along a z-order curve of their centroids so each run of
+    // CLUSTER_SIZE triangles is spatially compact, then cut the runs into clusters
+    void build_clusters() {
+        Vec lo = Vec{ INFINITY, INFINITY, INFINITY };
+        Vec hi = Vec{ -INFINITY, -INFINITY, -INFINITY };
+        for (Triangle& t : this->triangles) {
+            for (Vec& v : t.p) {
+                lo = Vec{ std::min(lo.x, v.x), std::min(lo.y, v.y), std::min(lo.z, v.z) };
+                hi = Vec{ std::max(hi.x, v.x), std::max(hi.y, v.y), std::max(hi.z, v.z) };
+            }
+        }
+
+        auto spread = [](uint32_t v) {
+            // insert two zero bits between each of the low 10 bits
+            v = (v | (v << 16)) & 0x030000FF;
+            v = (v | (v << 8))  & 0x0300F00F;
+            v = (v | (v << 4))  & 0x030C30C3;
+            v = (v | (v << 2))  & 0x09249249;
+            return v;
+        };
+        auto quantize = [](double v, double lo, double hi) {
+            return hi > lo ? (uint32_t)((v - lo) / (hi - lo) * 1023.0) : 0u;
+        };
+
+        std::vector<std::pair<uint32_t, size_t>> order(this->triangles.size());
+        for (size_t i = 0; i < this->triangles.size(); i++) {
+            Triangle& t = this->triangles[i];
+            double cx = (t.p[0].x + t.p[1].x + t.p[2].x) / 3;
+            double cy = (t.p[0].y + t.p[1].y + t.p[2].y) / 3;
+            double cz = (t.p[0].z + t.p[1].z + t.p[2].z) / 3;
+            uint32_t code = spread(quantize(cx, lo.x, hi.x))
+                | (spread(quantize(cy, lo.y, hi.y)) << 1)
+                | (spread(quantize(cz, lo.z, hi.z)) << 2);
+            order[i] = { code, i };
+        }
+        std::sort(order.begin(), order.end());
+
+        std::vector<Triangle> sorted;
+        std::vector<uint32_t> sorted_indices;
+        sorted.reserve(this->triangles.size());
+        sorted_indices.reserve(this->indices.size());
+        for (auto& o : order) {
+            sorted.push_back(this->triangles[o.second]);
+            for (int k = 0; k < 3; k++) {
+                sorted_indices.push_back(this->indices[o.second * 3 + k]);
+            }
+        }
+        this->triangles.swap(sorted);
+        this->indices.swap(sorted_indices);
+
+        this->clusters.clear();
+        for (size_t first = 0; first < this->triangles.size(); first += CLUSTER_SIZE) {
+            Cluster c;
+            c.first = first;
+            c.count = std::min((size_t)CLUSTER_SIZE, this->triangles.size() - first);
+            this->clusters.push_back(c);
+        }
+        build_bounds();
+    }
+
+    // box, sphere and normal cone of every cluster from its triangles
+    void build_bounds() {
+        for (Cluster& c : this->clusters) {
+            c.bmin = Vec{ INFINITY, INFINITY, INFINITY };
+            c.bmax = Vec{ -INFINITY, -INFINITY, -INFINITY };
+            for (size_t i = c.first; i < c.first + c.count; i++) {
+                for (Vec& v : this->triangles[i].p) {
+                    c.bmin = Vec{ std::min(c.bmin.x, v.x), std::min(c.bmin.y, v.y), std::min(c.bmin.z, v.z) };
+                    c.bmax = Vec{ std::max(c.bmax.x, v.x), std::max(c.bmax.y, v.y), std::max(c.bmax.z, v.z) };
+                }
+            }
+
+            Vec3<double> center = Vec3<double>{ c.bmin.x + c.bmax.x, c.bmin.y + c.bmax.y, c.bmin.z + c.bmax.z } * 0.5;
+            double radius2 = 0;
+            Vec3<double> axis = Vec3<double>{};
+            std::vector<Vec3<double>> normals;
+            for (size_t i = c.first; i < c.first + c.count; i++) {
+                Vec3<double> p[3];
+                for (int k = 0; k < 3; k++) {
+                    Vec& v = this->triangles[i].p[k];
+                    p[k] = Vec3<double>{ v.x, v.y, v.z };
+                    radius2 = std::max(radius2, dot(p[k] - center, p[k] - center));
+                }
+                Vec3<double> n = cross(p[1] - p[0], p[2] - p[0]);
+                if (dot(n, n) == 0)
+                    continue;
+                normals.push_back(normalize(n));
+                axis = axis + normals.back();
+            }
+            c.center = Vec3<float>{ (float)center.x, (float)center.y, (float)center.z };
+            // rounded out so the float sphere still holds every vertex
+            c.radius = (float)std::sqrt(radius2) * 1.0001f;
+
+            // the cone holds every normal, once any is more than 90 degrees
+            // from the axis no viewpoint can have them all facing away
+            c.cone_cutoff = 1;
+            if (dot(axis, axis) > 0) {
+                axis = normalize(axis);
+                double min_dp = 1;
+                for (Vec3<double>& n : normals) {
+                    min_dp = std::min(min_dp, dot(n, axis));
+                }
+                if (min_dp > 0)
+                    c.cone_cutoff = (float)std::sqrt(1 - min_dp * min_dp);
+            }
+            c.cone_axis = Vec3<float>{ (float)axis.x, (float)axis.y, (float)axis.z };
+        }
+    }
+
+    void load(const char* path) {
+        char* text = file_read(path);
+        assert(text);
+
+        char* next = strtok(text, " ");
+        for (size_t i = 0; next != NULL; next = strtok(NULL, " \n\r")) {
+            if (streq("v", next)) {
+                Vec v;
+                next = strtok(NULL, " \n");
+                v.x = atof(next);
+                next = strtok(NULL, " \n");
+                v.y = atof(next);
+                next = strtok(NULL, " \n");
+                v.z = atof(next);
+                this->vertices.push_back(v);
+            }
+            else if (streq("f", next)) {
+                next = strtok(NULL, " \n");
+                int f1 = atoi(next) - 1;
+                next = strtok(NULL, " \n");
+                int f2 = atoi(next) - 1;
+                next = strtok(NULL, " \n");
+                int f3 = atoi(next) - 1;
+                // use *.obj lookup table indices
+                this->triangles.push_back(Triangle{ this->vertices[f1], this->vertices[f2], this->vertices[f3] });
+                this->indices.push_back(f1);
+                this->indices.push_back(f2);
+                this->indices.push_back(f3);
+            }
+        }
+         free(text);
+    }
+};
+
+// per frame counters, printed with the stats key
+struct Stats {
+    size_t clusters = 0;
+    size_t clusters_occluded = 0;
+    size_t triangles_occluded = 0;
+    size_t clusters_coarse = 0;   // drawn from their coarse level
+    size_t clusters_frustum = 0;  // bounding sphere outside the view
+    size_t clusters_backface = 0; // normal cone facing away from the camera
+    size_t triangles_culled = 0;  // in clusters dropped by either
+    size_t triangles_degenerate = 0; // no area once snapped to the subpixel grid
+    size_t triangles_missed = 0;     // between pixel centers, would draw nothing
+    size_t frames_temporal = 0; // drawn from the last full frame's visible set
+    size_t frames_reused = 0;   // nothing changed, last frame presented again
+    size_t triangles_raster = 0;
+    size_t edges = 0;
+    size_t edges_drawn = 0;
+    double geometry_ms = 0;
+    double raster_ms = 0;
+    double present_ms = 0;   // swap and upload on the render thread
+    double latency_ms = 0;   // camera read to frame presented
+    int latency_frames = 0;  // updates the shown frame lags input by
+    double render_scale = 1;
+    double lod_error = 0;
+
+    void print() {
+        printf("clusters: %zu, occluded: %zu (%zu tris)\n", clusters, clusters_occluded, triangles_occluded);
+        printf("culled clusters: %zu frustum, %zu backface (%zu tris)\n", clusters_frustum, clusters_backface, triangles_culled);
+        printf("raster tris: %zu, degenerate: %zu, no samples: %zu\n", triangles_raster, triangles_degenerate, triangles_missed);
+        printf("edges: %zu, drawn: %zu\n", edges, edges_drawn);
+        printf("geometry: %.3f ms, raster: %.3f ms, present: %.3f ms\n", geometry_ms, raster_ms, present_ms);
+        printf("latency: %.3f ms, %d frames behind input\n", latency_ms, latency_frames);
+        printf("temporal frames: %zu, reused frames: %zu\n", frames_temporal, frames_reused);
+        printf("render scale: %.2f, lod error: %.1f px (%zu clusters coarse)\n", render_scale, lod_error, clusters_coarse);
+    }
+};
+
+} // trace
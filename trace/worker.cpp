@@ -0,0 +1,54 @@
+#include "../prof/zones.hpp"
+#include "worker.hpp"
+
+namespace trace {
+
+Worker::Worker(const char *name)
+{
+    this->thread = std::thread([this, name]() {
+        prof::zone_thread_name(name);
+        std::unique_lock<std::mutex> lock(this->mutex);
+        for (;;) {
+            this->cv.wait(lock, [this]() { return this->busy || this->quit; });
+            if (this->quit)
+                return;
+            lock.unlock();
+            {
+                PROF_ZONE("worker job");
+                this->job();
+            }
+            lock.lock();
+            this->job = nullptr;
+            this->busy = false;
+            this->cv.notify_all();
+        }
+    });
+}
+
+Worker::~Worker()
+{
+    {
+        std::unique_lock<std::mutex> lock(this->mutex);
+        this->cv.wait(lock, [this]() { return !this->busy; });
+        this->quit = true;
+    }
+    this->cv.notify_all();
+    this->thread.join();
+}
+
+void Worker::submit(std::function<void()> job)
+{
+    std::unique_lock<std::mutex> lock(this->mutex);
+    this->cv.wait(lock, [this]() { return !this->busy; });
+    this->job = std::move(job);
+    this->busy = true;
+    this->cv.notify_all();
+}
+
+void Worker::wait()
+{
+    std::unique_lock<std::mutex> lock(this->mutex);
+    this->cv.wait(lock, [this]() { return !this->busy; });
+}
+
+} // trace
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+namespace trace {
+
+/******************************************************************************
+ * Worker
+ *
+ * One background thread running one job at a time, a queue bounded to a
+ * single entry. submit() waits for the previous job to finish before handing
+ * over the next, so a producer can never run more than one job ahead.
+ */
+
+struct Worker {
+    std::thread thread;
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::function<void()> job;
+    bool busy = false;
+    bool quit = false;
+
+    // name is the thread's in zone dumps, a string literal
+    explicit Worker(const char *name);
+    ~Worker();
+    // run job on the worker thread, after the previous one is done
+    void submit(std::function<void()> job);
+    // block until the worker is idle
+    void wait();
+};
+
+} // trace